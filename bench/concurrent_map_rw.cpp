@@ -0,0 +1,90 @@
+/**
+ * read/write throughput of sjtu::concurrent_map against std::map behind a
+ * std::shared_timed_mutex, for 1 to max threads, each doing reads with a given
+ * percentage of writes mixed in.
+ * usage: concurrent_map_rw [max threads] [write %] [ms per run]    (default 64 1 200)
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include "concurrent_map.hpp"
+
+const int KEYS = 1 << 16;
+
+std::atomic<long> sink(0);//keeps the reads from being optimized out
+
+struct locked_map {
+    std::map<int, long> m;
+    mutable std::shared_timed_mutex mu;
+
+    bool find(int k, long &v) const {
+        std::shared_lock<std::shared_timed_mutex> l(mu);
+        auto it = m.find(k);
+        if (it == m.end())return false;
+        v = it->second;
+        return true;
+    }
+
+    void insert_or_assign(int k, long v) {
+        std::unique_lock<std::shared_timed_mutex> l(mu);
+        m[k] = v;
+    }
+
+    void erase(int k) {
+        std::unique_lock<std::shared_timed_mutex> l(mu);
+        m.erase(k);
+    }
+};
+
+// million operations per second over all threads
+template<class M>
+double run(M &m, int threads, int wpct, int ms) {
+    std::atomic<bool> stop(false);
+    std::atomic<long> ops(0);
+    std::vector<std::thread> th;
+    for (int t = 0; t < threads; ++t)
+        th.emplace_back([&, t] {
+            unsigned x = t * 2654435761u + 1;
+            long n = 0, s = 0;
+            for (; !stop.load(std::memory_order_relaxed); ++n) {
+                x = x * 1103515245 + 12345;
+                int k = (x >> 8) % KEYS;
+                if ((int) (x >> 24) % 100 < wpct) {
+                    if (x & 16)m.insert_or_assign(k, k);
+                    else m.erase(k);
+                } else {
+                    long v;
+                    if (m.find(k, v))s += v;
+                }
+            }
+            ops += n;
+            sink += s;
+        });
+    auto t0 = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    stop = true;
+    for (auto &t : th)t.join();
+    double d = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return ops / d / 1e6;
+}
+
+int main(int argc, char **argv) {
+    int maxt = argc > 1 ? atoi(argv[1]) : 64, wpct = argc > 2 ? atoi(argv[2]) : 1, ms = argc > 3 ? atoi(argv[3]) : 200;
+    sjtu::concurrent_map<int, long> cm;
+    locked_map lm;
+    for (int k = 0; k < KEYS; k += 2) {
+        cm.insert_or_assign(k, k);
+        lm.insert_or_assign(k, k);
+    }
+    printf("%d%% writes, %u hardware threads, Mops/s\n", wpct, std::thread::hardware_concurrency());
+    printf("%8s %16s %16s\n", "threads", "concurrent_map", "map+rwlock");
+    for (int t = 1; t <= maxt; t *= 2)
+        printf("%8d %16.2f %16.2f\n", t, run(cm, t, wpct, ms), run(lm, t, wpct, ms));
+    return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * throughput of sjtu::concurrent_priority_queue against std::priority_queue behind
+ * a std::mutex, for 1 to max threads.
+ *   churn: on a prefilled queue, every thread alternates push and pop.
+ *   drain: the elements arrive through one merge, so they all start in one shard,
+ *          and the threads pop them all; this is where shard rebalancing matters.
+ * usage: concurrent_priority_queue [max threads] [elements] [ms per churn run]    (default 64 1000000 200)
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "concurrent_priority_queue.hpp"
+
+typedef sjtu::concurrent_priority_queue<long> cpq;
+
+struct locked_queue {
+    std::priority_queue<long> q;
+    std::mutex mu;
+
+    void push(long v) {
+        std::lock_guard<std::mutex> l(mu);
+        q.push(v);
+    }
+
+    bool try_pop(long &v) {
+        std::lock_guard<std::mutex> l(mu);
+        if (q.empty())return false;
+        v = q.top();
+        q.pop();
+        return true;
+    }
+};
+
+// million operations per second over all threads
+template<class Q>
+double churn(Q &q, int threads, int ms) {
+    std::atomic<bool> stop(false);
+    std::atomic<long> ops(0);
+    std::vector<std::thread> th;
+    for (int t = 0; t < threads; ++t)
+        th.emplace_back([&, t] {
+            unsigned x = t * 2654435761u + 1;
+            long n = 0, v;
+            for (; !stop.load(std::memory_order_relaxed); n += 2) {
+                x = x * 1103515245 + 12345;
+                q.push(x >> 4);
+                q.try_pop(v);
+            }
+            ops += n;
+        });
+    auto t0 = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    stop = true;
+    for (auto &t : th)t.join();
+    return ops / std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / 1e6;
+}
+
+// milliseconds for the threads to pop everything
+template<class Q>
+double drain(Q &q, int threads) {
+    std::atomic<bool> go(false);
+    std::vector<std::thread> th;
+    for (int t = 0; t < threads; ++t)
+        th.emplace_back([&] {
+            while (!go.load())std::this_thread::yield();
+            long v;
+            while (q.try_pop(v));
+        });
+    auto t0 = std::chrono::steady_clock::now();
+    go = true;
+    for (auto &t : th)t.join();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char **argv) {
+    int maxt = argc > 1 ? atoi(argv[1]) : 64, ms = argc > 3 ? atoi(argv[3]) : 200;
+    long n = argc > 2 ? atol(argv[2]) : 1000000;
+    printf("%u hardware threads, %ld elements\n", std::thread::hardware_concurrency(), n);
+    printf("%8s %14s %14s %14s %14s\n", "threads", "churn cpq", "churn locked", "drain cpq", "drain locked");
+    printf("%8s %14s %14s %14s %14s\n", "", "Mops/s", "Mops/s", "ms", "ms");
+    for (int t = 1; t <= maxt; t *= 2) {
+        cpq a;
+        locked_queue b;
+        for (long i = 0; i < n; ++i)a.push(i * 7919 % n), b.push(i * 7919 % n);
+        double ca = churn(a, t, ms), cb = churn(b, t, ms);
+        cpq c;
+        locked_queue d;
+        sjtu::priority_queue<long> h;
+        for (long i = 0; i < n; ++i)h.push(i * 7919 % n), d.push(i * 7919 % n);
+        c.merge(h);
+        printf("%8d %14.2f %14.2f %14.1f %14.1f\n", t, ca, cb, drain(c, t), drain(d, t));
+    }
+    return 0;
+}
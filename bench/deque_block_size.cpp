@@ -0,0 +1,57 @@
+/**
+ * throughput of sjtu::deque under different block capacity policies.
+ * usage: deque_block_size [n]    (default 1000000)
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "deque.hpp"
+
+struct big {
+    char pad[4096];
+};
+
+template<class T, class P>
+void run(const char *name, size_t n) {
+    typedef sjtu::deque<T, P> D;
+    D d;
+    for (size_t i = 0; i < n; ++i)d.push_back(T());
+    unsigned x = 1;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; ++i)d.push_back(T()), d.pop_front();
+    auto t1 = std::chrono::steady_clock::now();
+    long s = 0;
+    for (size_t i = 0; i < n; ++i) {
+        x = x * 1103515245 + 12345;
+        s += *(const char *) &d[x % n];
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    size_t m = n / 100 > 2000 ? 2000 : n / 100 + 1;
+    for (size_t i = 0; i < m; ++i) {
+        x = x * 1103515245 + 12345;
+        d.insert(d.begin() + x % d.size(), T());
+        x = x * 1103515245 + 12345;
+        d.erase(d.begin() + x % d.size());
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    printf("%-18s %9zu  push/pop %8.1f ns  random access %8.1f ns  insert/erase %9.1f ns  (%ld)\n", name, n,
+           std::chrono::duration<double, std::nano>(t1 - t0).count() / n,
+           std::chrono::duration<double, std::nano>(t2 - t1).count() / n,
+           std::chrono::duration<double, std::nano>(t3 - t2).count() / m, s);
+}
+
+template<class T>
+void all(const char *type, size_t n) {
+    printf("-- %s\n", type);
+    run<T, sjtu::sqrt_block>("sqrt (default)", n);
+    run<T, sjtu::fixed_block<64> >("fixed 64", n);
+    run<T, sjtu::fixed_block<500> >("fixed 500", n);
+    run<T, sjtu::fixed_block<4096> >("fixed 4096", n);
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    all<int>("int", n);
+    all<big>("4KB struct", n / 100);
+    return 0;
+}
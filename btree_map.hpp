@@ -0,0 +1,731 @@
+/**
+ * an ordered map with the interface of sjtu::map, stored as a B+ tree
+ */
+#ifndef SJTU_BTREE_MAP_HPP
+#define SJTU_BTREE_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <utility>
+#include "utility.hpp"
+#include "compare_base.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+ * values live in leaves of about 1KB, kept in key order and linked into a
+ * list, and inner nodes hold contiguous arrays of separator keys.
+ * a lookup reads one contiguous key array per level instead of chasing one
+ * pointer per comparison, and an entry costs little more than its value.
+ *
+ * unlike sjtu::map, insert and erase move values inside a leaf,
+ * so they invalidate iterators into the leaves they touch.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>
+> class btree_map : public compare_base<Compare> {
+public:
+    using compare_base<Compare>::comp;
+    typedef pair<const Key, T> value_type;
+
+    enum {
+        // leaf capacity (values) and inner capacity (children)
+        LN = sizeof(value_type) * 8 > 1024 ? 8 : 1024 / sizeof(value_type),
+        IN = (sizeof(Key) + sizeof(void *)) * 8 > 1024 ? 8 : 1024 / (sizeof(Key) + sizeof(void *)),
+        // inner nodes have at least IN / 2 children, so this bounds the depth
+        MAXD = 64
+    };
+
+    struct node {
+        int n;//values in a leaf, children in an inner node
+        bool leaf;
+    };
+
+    /**
+     * the leaves form a circular list through the end leaf ed, which is empty.
+     */
+    struct leaf_node : node {
+        leaf_node *prv, *nxt;
+        alignas(value_type) unsigned char buf[LN * sizeof(value_type)];
+
+        leaf_node() : prv(this), nxt(this) {
+            this->n = 0;
+            this->leaf = true;
+        }
+
+        value_type *val() { return (value_type *) buf; }
+
+        // put this leaf right after p
+        void link(leaf_node *p) {
+            prv = p;
+            nxt = p->nxt;
+            nxt->prv = this;
+            p->nxt = this;
+        }
+
+        void unlink() {
+            prv->nxt = nxt;
+            nxt->prv = prv;
+        }
+    };
+
+    /**
+     * all keys in ch[i] are less than key()[i], all keys in ch[i + 1] are not.
+     */
+    struct inner_node : node {
+        alignas(Key) unsigned char buf[(IN - 1) * sizeof(Key)];
+        node *ch[IN];
+
+        inner_node() {
+            this->n = 0;
+            this->leaf = false;
+        }
+
+        Key *key() { return (Key *) buf; }
+    };
+
+    template<class V>
+    static void relocate(V *to, V *from) {
+        new(to) V(std::move(*from));
+        from->~V();
+    }
+
+    /**
+     * number of keys in a[0, n) less than key (upper: not greater than key).
+     * binary search narrows the range, then a branch-free count over a short
+     * contiguous window finishes it, which compilers vectorize for plain keys.
+     */
+    int lower(const Key *a, int n, const Key &key) const {
+        int l = 0;
+        while (n - l > 16) {
+            int m = (l + n) >> 1;
+            if (comp()(a[m], key))l = m + 1;
+            else n = m;
+        }
+        int c = l;
+        for (int i = l; i < n; ++i)c += comp()(a[i], key);
+        return c;
+    }
+
+    int upper(const Key *a, int n, const Key &key) const {
+        int l = 0;
+        while (n - l > 16) {
+            int m = (l + n) >> 1;
+            if (comp()(key, a[m]))n = m;
+            else l = m + 1;
+        }
+        int c = l;
+        for (int i = l; i < n; ++i)c += !comp()(key, a[i]);
+        return c;
+    }
+
+    int lower(leaf_node *p, const Key &key) const {
+        value_type *a = p->val();
+        int l = 0, n = p->n;
+        while (n - l > 16) {
+            int m = (l + n) >> 1;
+            if (comp()(a[m].first, key))l = m + 1;
+            else n = m;
+        }
+        int c = l;
+        for (int i = l; i < n; ++i)c += comp()(a[i].first, key);
+        return c;
+    }
+
+    node *root;
+    leaf_node *ed;
+    size_t sz;
+
+    class const_iterator;
+
+    class iterator {
+    private:
+    public:
+        leaf_node *cur;
+        int pos;
+
+        bool check_invalid() const { return cur == NULL; }
+
+        bool check_end() const { return cur->n == 0; }
+
+        iterator(leaf_node *_cur = NULL, int _pos = 0) : cur(_cur), pos(_pos) {}
+
+        iterator(const iterator &other) : cur(other.cur), pos(other.pos) {}
+
+        iterator &operator=(const iterator &other) {
+            cur = other.cur;
+            pos = other.pos;
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        iterator &operator++() {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            if (++pos == cur->n) {
+                cur = cur->nxt;
+                pos = 0;
+            }
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator ret(*this);
+            --*this;
+            return ret;
+        }
+
+        iterator &operator--() {
+            if (check_invalid())throw invalid_iterator();
+            if (pos) {
+                --pos;
+                return *this;
+            }
+            if (cur->prv->n == 0)throw invalid_iterator();
+            cur = cur->prv;
+            pos = cur->n - 1;
+            return *this;
+        }
+
+        value_type &operator*() const {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            return cur->val()[pos];
+        }
+
+        bool operator==(const iterator &rhs) const { return cur == rhs.cur && pos == rhs.pos; }
+
+        bool operator==(const const_iterator &rhs) const { return cur == rhs.cur && pos == rhs.pos; }
+
+        bool operator!=(const iterator &rhs) const { return cur != rhs.cur || pos != rhs.pos; }
+
+        bool operator!=(const const_iterator &rhs) const { return cur != rhs.cur || pos != rhs.pos; }
+
+        value_type *operator->() const noexcept {
+            return cur->val() + pos;
+        }
+    };
+
+    class const_iterator {
+    private:
+    public:
+        leaf_node *cur;
+        int pos;
+
+        bool check_invalid() const { return cur == NULL; }
+
+        bool check_end() const { return cur->n == 0; }
+
+        const_iterator(leaf_node *_cur = NULL, int _pos = 0) : cur(_cur), pos(_pos) {}
+
+        const_iterator(const const_iterator &other) : cur(other.cur), pos(other.pos) {}
+
+        const_iterator(const iterator &other) : cur(other.cur), pos(other.pos) {}
+
+        const_iterator &operator=(const const_iterator &other) {
+            cur = other.cur;
+            pos = other.pos;
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        const_iterator &operator++() {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            if (++pos == cur->n) {
+                cur = cur->nxt;
+                pos = 0;
+            }
+            return *this;
+        }
+
+        const_iterator operator--(int) {
+            const_iterator ret(*this);
+            --*this;
+            return ret;
+        }
+
+        const_iterator &operator--() {
+            if (check_invalid())throw invalid_iterator();
+            if (pos) {
+                --pos;
+                return *this;
+            }
+            if (cur->prv->n == 0)throw invalid_iterator();
+            cur = cur->prv;
+            pos = cur->n - 1;
+            return *this;
+        }
+
+        const value_type &operator*() const {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            return cur->val()[pos];
+        }
+
+        bool operator==(const const_iterator &rhs) const { return cur == rhs.cur && pos == rhs.pos; }
+
+        bool operator==(const iterator &rhs) const { return cur == rhs.cur && pos == rhs.pos; }
+
+        bool operator!=(const const_iterator &rhs) const { return cur != rhs.cur || pos != rhs.pos; }
+
+        bool operator!=(const iterator &rhs) const { return cur != rhs.cur || pos != rhs.pos; }
+
+        const value_type *operator->() const noexcept {
+            return cur->val() + pos;
+        }
+    };
+
+    btree_map() {
+        root = NULL;
+        ed = new leaf_node;
+        sz = 0;
+    }
+
+    explicit btree_map(const Compare &c) : compare_base<Compare>(c) {
+        root = NULL;
+        ed = new leaf_node;
+        sz = 0;
+    }
+
+    // copy the subtree of y, appending its leaves before ed
+    node *copy(node *y) {
+        if (y->leaf) {
+            leaf_node *p = (leaf_node *) y, *q = new leaf_node;
+            for (; q->n < p->n; ++q->n)new(q->val() + q->n) value_type(p->val()[q->n]);
+            q->link(ed->prv);
+            return q;
+        }
+        inner_node *p = (inner_node *) y, *q = new inner_node;
+        for (; q->n < p->n; ++q->n) {
+            if (q->n)new(q->key() + q->n - 1) Key(p->key()[q->n - 1]);
+            q->ch[q->n] = copy(p->ch[q->n]);
+        }
+        return q;
+    }
+
+    btree_map(const btree_map &other) : compare_base<Compare>(other) {
+        root = NULL;
+        ed = new leaf_node;
+        sz = other.sz;
+        if (other.root != NULL)root = copy(other.root);
+    }
+
+    /**
+     * a moved-from map has no end leaf, it is recreated on the next insertion.
+     */
+    btree_map(btree_map &&other) noexcept
+            : compare_base<Compare>(other), root(other.root), ed(other.ed), sz(other.sz) {
+        other.root = NULL;
+        other.ed = NULL;
+        other.sz = 0;
+    }
+
+    void del(node *x) {
+        if (x->leaf) {
+            leaf_node *p = (leaf_node *) x;
+            for (int i = 0; i < p->n; ++i)p->val()[i].~value_type();
+            delete p;
+            return;
+        }
+        inner_node *p = (inner_node *) x;
+        for (int i = 0; i < p->n; ++i) {
+            if (i)p->key()[i - 1].~Key();
+            del(p->ch[i]);
+        }
+        delete p;
+    }
+
+    btree_map &operator=(const btree_map &other) {
+        if (this == &other)return *this;
+        compare_base<Compare>::operator=(other);
+        clear();
+        if (other.root != NULL)root = copy(other.root);
+        sz = other.sz;
+        return *this;
+    }
+
+    btree_map &operator=(btree_map &&other) noexcept {
+        if (this == &other)return *this;
+        compare_base<Compare>::operator=(other);
+        if (root != NULL)del(root);
+        delete ed;
+        root = other.root;
+        ed = other.ed;
+        sz = other.sz;
+        other.root = NULL;
+        other.ed = NULL;
+        other.sz = 0;
+        return *this;
+    }
+
+    ~btree_map() {
+        if (root != NULL)del(root);
+        delete ed;
+    }
+
+    /**
+     * descend to the leaf where key belongs.
+     * path[0, d) are the inner nodes on the way and idx[i] the child taken in path[i].
+     */
+    leaf_node *descend(const Key &key, inner_node **path, int *idx, int &d) const {
+        node *x = root;
+        d = 0;
+        while (!x->leaf) {
+            inner_node *p = (inner_node *) x;
+            int i = upper(p->key(), p->n - 1, key);
+            path[d] = p;
+            idx[d++] = i;
+            x = p->ch[i];
+        }
+        return (leaf_node *) x;
+    }
+
+    // the leaf and index holding key, or NULL
+    leaf_node *search(const Key &key, int &i) const {
+        if (root == NULL)return NULL;
+        node *x = root;
+        while (!x->leaf) {
+            inner_node *p = (inner_node *) x;
+            x = p->ch[upper(p->key(), p->n - 1, key)];
+        }
+        leaf_node *l = (leaf_node *) x;
+        i = lower(l, key);
+        if (i < l->n && !comp()(key, l->val()[i].first))return l;
+        return NULL;
+    }
+
+    // insert key k and child r right after child i of p, p must not be full
+    static void inner_insert(inner_node *p, int i, const Key &k, node *r) {
+        for (int j = p->n - 1; j > i; --j) {
+            relocate(p->key() + j, p->key() + j - 1);
+            p->ch[j + 1] = p->ch[j];
+        }
+        new(p->key() + i) Key(k);
+        p->ch[i + 1] = r;
+        ++p->n;
+    }
+
+    // r was split off to the right of path[d - 1]->ch[idx[d - 1]], with separator k
+    void insert_up(inner_node **path, int *idx, int d, const Key &k, node *r) {
+        if (d == 0) {
+            inner_node *p = new inner_node;
+            p->n = 2;
+            p->ch[0] = root;
+            p->ch[1] = r;
+            new(p->key()) Key(k);
+            root = p;
+            return;
+        }
+        inner_node *p = path[d - 1], *q;
+        int i = idx[d - 1];
+        if (p->n < IN) {
+            inner_insert(p, i, k, r);
+            return;
+        }
+        int h = IN / 2;
+        q = new inner_node;
+        Key up(std::move(p->key()[h - 1]));
+        p->key()[h - 1].~Key();
+        for (int j = h; j < IN; ++j, ++q->n) {
+            if (j > h)relocate(q->key() + q->n - 1, p->key() + j - 1);
+            q->ch[q->n] = p->ch[j];
+        }
+        p->n = h;
+        if (i < h)inner_insert(p, i, k, r);
+        else inner_insert(q, i - h, k, r);
+        insert_up(path, idx, d - 1, up, q);
+    }
+
+    /**
+     * construct a value from args at index i of leaf l, as found by descend.
+     */
+    template<class... Args>
+    iterator insert_at(leaf_node *l, int i, inner_node **path, int *idx, int d, Args &&... args) {
+        if (l->n == LN) {
+            int h = LN / 2;
+            leaf_node *r = new leaf_node;
+            for (int j = h; j < LN; ++j, ++r->n)relocate(r->val() + r->n, l->val() + j);
+            l->n = h;
+            r->link(l);
+            insert_up(path, idx, d, r->val()[0].first, r);
+            if (i > h) {
+                i -= h;
+                l = r;
+            }
+        }
+        value_type *v = l->val();
+        for (int j = l->n; j > i; --j)relocate(v + j, v + j - 1);
+        try {
+            new(v + i) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            for (int j = i; j < l->n; ++j)relocate(v + j, v + j + 1);
+            throw;
+        }
+        ++l->n;
+        ++sz;
+        return iterator(l, i);
+    }
+
+    /**
+     * find key, or construct a value from args where it belongs.
+     */
+    template<class... Args>
+    pair<iterator, bool> Insert(const Key &key, Args &&... args) {
+        if (ed == NULL)ed = new leaf_node;
+        if (root == NULL) {
+            leaf_node *l = new leaf_node;
+            l->link(ed);
+            root = l;
+        }
+        inner_node *path[MAXD];
+        int idx[MAXD], d;
+        leaf_node *l = descend(key, path, idx, d);
+        int i = lower(l, key);
+        if (i < l->n && !comp()(key, l->val()[i].first))return pair<iterator, bool>(iterator(l, i), false);
+        return pair<iterator, bool>(insert_at(l, i, path, idx, d, std::forward<Args>(args)...), true);
+    }
+
+    T &at(const Key &key) {
+        int i;
+        leaf_node *l = search(key, i);
+        if (l == NULL)throw index_out_of_bound();
+        return l->val()[i].second;
+    }
+
+    const T &at(const Key &key) const {
+        int i;
+        leaf_node *l = search(key, i);
+        if (l == NULL)throw index_out_of_bound();
+        return l->val()[i].second;
+    }
+
+    T &operator[](const Key &key) {
+        return Insert(key, key, T()).first->second;
+    }
+
+    T &operator[](Key &&key) {
+        return Insert(key, std::move(key), T()).first->second;
+    }
+
+    const T &operator[](const Key &key) const {
+        return at(key);
+    }
+
+    iterator begin() {
+        if (ed == NULL)return iterator();
+        return iterator(ed->nxt, 0);
+    }
+
+    const_iterator cbegin() const {
+        if (ed == NULL)return const_iterator();
+        return const_iterator(ed->nxt, 0);
+    }
+
+    iterator end() {
+        return iterator(ed, 0);
+    }
+
+    const_iterator cend() const {
+        return const_iterator(ed, 0);
+    }
+
+    bool empty() const { return !sz; }
+
+    size_t size() const { return sz; }
+
+    void clear() {
+        if (root != NULL)del(root);
+        root = NULL;
+        if (ed == NULL)ed = new leaf_node;
+        ed->prv = ed->nxt = ed;
+        sz = 0;
+    }
+
+    pair<iterator, bool> insert(const value_type &value) {
+        return Insert(value.first, value);
+    }
+
+    pair<iterator, bool> insert(value_type &&value) {
+        return Insert(value.first, std::move(value));
+    }
+
+    template<class... Args>
+    pair<iterator, bool> emplace(Args &&... args) {
+        value_type v(std::forward<Args>(args)...);
+        return Insert(v.first, std::move(v));
+    }
+
+    template<class... Args>
+    pair<iterator, bool> try_emplace(const Key &key, Args &&... args) {
+        int i;
+        leaf_node *l = search(key, i);
+        if (l != NULL)return pair<iterator, bool>(iterator(l, i), false);
+        return Insert(key, key, T(std::forward<Args>(args)...));
+    }
+
+    template<class... Args>
+    pair<iterator, bool> try_emplace(Key &&key, Args &&... args) {
+        int i;
+        leaf_node *l = search(key, i);
+        if (l != NULL)return pair<iterator, bool>(iterator(l, i), false);
+        return Insert(key, std::move(key), T(std::forward<Args>(args)...));
+    }
+
+    // replace key()[i] of p by k
+    static void set_key(inner_node *p, int i, const Key &k) {
+        p->key()[i].~Key();
+        new(p->key() + i) Key(k);
+    }
+
+    // remove key()[i] and ch[i + 1] from p
+    static void inner_erase(inner_node *p, int i) {
+        p->key()[i].~Key();
+        for (int j = i + 1; j < p->n - 1; ++j) {
+            relocate(p->key() + j - 1, p->key() + j);
+            p->ch[j] = p->ch[j + 1];
+        }
+        --p->n;
+    }
+
+    // leaf l = path[d - 1]->ch[idx[d - 1]] has too few values
+    void fix_leaf(leaf_node *l, inner_node **path, int *idx, int d) {
+        inner_node *p = path[d - 1];
+        int i = idx[d - 1];
+        leaf_node *s;
+        if (i > 0 && (s = (leaf_node *) p->ch[i - 1])->n > LN / 2) {
+            for (int j = l->n; j > 0; --j)relocate(l->val() + j, l->val() + j - 1);
+            relocate(l->val(), s->val() + --s->n);
+            ++l->n;
+            set_key(p, i - 1, l->val()[0].first);
+            return;
+        }
+        if (i + 1 < p->n && (s = (leaf_node *) p->ch[i + 1])->n > LN / 2) {
+            relocate(l->val() + l->n++, s->val());
+            for (int j = 1; j < s->n; ++j)relocate(s->val() + j - 1, s->val() + j);
+            --s->n;
+            set_key(p, i, s->val()[0].first);
+            return;
+        }
+        if (i > 0) {
+            s = (leaf_node *) p->ch[i - 1];
+            for (int j = 0; j < l->n; ++j)relocate(s->val() + s->n++, l->val() + j);
+            l->unlink();
+            delete l;
+            inner_erase(p, i - 1);
+        } else {
+            s = (leaf_node *) p->ch[i + 1];
+            for (int j = 0; j < s->n; ++j)relocate(l->val() + l->n++, s->val() + j);
+            s->unlink();
+            delete s;
+            inner_erase(p, i);
+        }
+        fix_inner(path, idx, d - 1);
+    }
+
+    // path[d] may have too few children after losing one
+    void fix_inner(inner_node **path, int *idx, int d) {
+        inner_node *p = path[d];
+        if (d == 0) {
+            if (p->n == 1) {
+                root = p->ch[0];
+                delete p;
+            }
+            return;
+        }
+        if (p->n >= IN / 2)return;
+        inner_node *g = path[d - 1], *s;
+        int i = idx[d - 1];
+        if (i > 0 && (s = (inner_node *) g->ch[i - 1])->n > IN / 2) {
+            for (int j = p->n; j > 0; --j) {
+                if (j > 1)relocate(p->key() + j - 1, p->key() + j - 2);
+                p->ch[j] = p->ch[j - 1];
+            }
+            relocate(p->key(), g->key() + i - 1);
+            relocate(g->key() + i - 1, s->key() + s->n - 2);
+            p->ch[0] = s->ch[--s->n];
+            ++p->n;
+            return;
+        }
+        if (i + 1 < g->n && (s = (inner_node *) g->ch[i + 1])->n > IN / 2) {
+            relocate(p->key() + p->n - 1, g->key() + i);
+            relocate(g->key() + i, s->key());
+            p->ch[p->n++] = s->ch[0];
+            for (int j = 1; j < s->n; ++j) {
+                if (j > 1)relocate(s->key() + j - 2, s->key() + j - 1);
+                s->ch[j - 1] = s->ch[j];
+            }
+            --s->n;
+            return;
+        }
+        inner_node *a, *b;
+        int k;
+        if (i > 0)a = (inner_node *) g->ch[i - 1], b = p, k = i - 1;
+        else a = p, b = (inner_node *) g->ch[i + 1], k = i;
+        new(a->key() + a->n - 1) Key(g->key()[k]);
+        for (int j = 0; j < b->n; ++j) {
+            if (j)relocate(a->key() + a->n - 1, b->key() + j - 1);
+            a->ch[a->n++] = b->ch[j];
+        }
+        delete b;
+        inner_erase(g, k);
+        fix_inner(path, idx, d - 1);
+    }
+
+    /**
+     * erase the element at pos.
+     *
+     * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+     */
+    void erase(iterator pos) {
+        if (pos.check_invalid() || pos.check_end() || root == NULL)throw invalid_iterator();
+        inner_node *path[MAXD];
+        int idx[MAXD], d;
+        leaf_node *l = descend(pos->first, path, idx, d);
+        if (l != pos.cur || pos.pos >= l->n)throw invalid_iterator();
+        value_type *v = l->val();
+        v[pos.pos].~value_type();
+        for (int j = pos.pos + 1; j < l->n; ++j)relocate(v + j - 1, v + j);
+        --l->n;
+        --sz;
+        if (d == 0) {
+            if (!l->n) {
+                l->unlink();
+                delete l;
+                root = NULL;
+            }
+        } else if (l->n < LN / 2)fix_leaf(l, path, idx, d);
+    }
+
+    size_t count(const Key &key) const {
+        int i;
+        return search(key, i) != NULL;
+    }
+
+    iterator find(const Key &key) {
+        int i;
+        leaf_node *l = search(key, i);
+        if (l == NULL)return end();
+        return iterator(l, i);
+    }
+
+    const_iterator find(const Key &key) const {
+        int i;
+        leaf_node *l = search(key, i);
+        if (l == NULL)return cend();
+        return const_iterator(l, i);
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef SJTU_COMPARE_BASE_HPP
+#define SJTU_COMPARE_BASE_HPP
+
+#include <type_traits>
+
+namespace sjtu {
+
+/**
+ * keeps the comparator of an ordered container.
+ * an empty comparator is inherited rather than stored, so it takes no space.
+ */
+template<class C, bool = std::is_empty<C>::value && !std::is_final<C>::value>
+class compare_base {
+    C c;
+public:
+    compare_base(const C &_c = C()) : c(_c) {}
+
+    const C &comp() const { return c; }
+
+    C key_comp() const { return c; }
+};
+
+template<class C>
+class compare_base<C, true> : private C {
+public:
+    compare_base(const C &_c = C()) : C(_c) {}
+
+    const C &comp() const { return *this; }
+
+    C key_comp() const { return *this; }
+};
+
+}
+
+#endif
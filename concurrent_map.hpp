@@ -0,0 +1,250 @@
+#ifndef SJTU_CONCURRENT_MAP_HPP
+#define SJTU_CONCURRENT_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include "utility.hpp"
+#include "compare_base.hpp"
+#include "exceptions.hpp"
+#include "persistent_tree.hpp"
+
+namespace sjtu {
+
+/**
+ * an ordered map for many reader threads and one writer at a time.
+ *
+ * the contents are a persistent_tree version behind an atomic root pointer.
+ * a writer builds the next version by path copying and publishes it with a
+ * single store, so readers never lock, never wait for the writer, and never
+ * see a half-done update.
+ *
+ * a reader announces itself by bumping a counter in one of SLOTS padded slots
+ * (picked per thread), on the side of the current epoch parity. a replaced root
+ * is retired, and once RETIRE of them pile up the writer flips the parity twice,
+ * each time waiting for the readers on the old side to leave. a reader that
+ * enters later can only load a newer root, so after that the retired versions
+ * are dropped. writers are serialized by a spinlock.
+ *
+ * readers get copies of values (or a callback run inside the read section),
+ * never references that could outlive the version they came from.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>
+> class concurrent_map : public compare_base<Compare> {
+public:
+    typedef pair<const Key, T> value_type;
+    typedef persistent_tree<Key, T, Compare> tree;
+    typedef typename tree::node node;
+
+    enum {
+        SLOTS = 64,
+        RETIRE = 32
+    };
+
+    struct alignas(64) slot {
+        std::atomic<long> cnt[2];
+
+        slot() {
+            cnt[0].store(0, std::memory_order_relaxed);
+            cnt[1].store(0, std::memory_order_relaxed);
+        }
+    };
+
+    std::atomic<node *> root;
+    std::atomic<size_t> sz;
+    std::atomic<unsigned> epoch;
+    mutable slot slots[SLOTS];
+    std::atomic_flag busy;
+    node *retired[RETIRE];
+    int nretired;
+
+    using compare_base<Compare>::comp;
+
+    static size_t slot_id() {
+        static std::atomic<size_t> next(0);
+        thread_local size_t id = next.fetch_add(1, std::memory_order_relaxed) % SLOTS;
+        return id;
+    }
+
+    // keeps every root loaded during its lifetime alive
+    class read_guard {
+    public:
+        std::atomic<long> *c;
+
+        explicit read_guard(const concurrent_map *m) {
+            c = m->slots[slot_id()].cnt + (m->epoch.load(std::memory_order_seq_cst) & 1);
+            c->fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        ~read_guard() {
+            c->fetch_sub(1, std::memory_order_release);
+        }
+    };
+
+    class write_guard {
+    public:
+        concurrent_map *m;
+
+        explicit write_guard(concurrent_map *_m) : m(_m) {
+            while (m->busy.test_and_set(std::memory_order_acquire))std::this_thread::yield();
+        }
+
+        ~write_guard() {
+            m->busy.clear(std::memory_order_release);
+        }
+    };
+
+    concurrent_map() : root(NULL), sz(0), epoch(0), nretired(0) {
+        busy.clear();
+    }
+
+    explicit concurrent_map(const Compare &c) : compare_base<Compare>(c), root(NULL), sz(0), epoch(0), nretired(0) {
+        busy.clear();
+    }
+
+    // shared between threads by reference, never copied
+    concurrent_map(const concurrent_map &) = delete;
+
+    concurrent_map &operator=(const concurrent_map &) = delete;
+
+    /**
+     * no reader or writer may be running.
+     */
+    ~concurrent_map() {
+        for (int i = 0; i < nretired; ++i)tree::drop(retired[i]);
+        tree::drop(root.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * wait until every reader that might still see a retired root has left,
+     * then drop the retired roots. called by the writer.
+     */
+    void synchronize() {
+        for (int i = 0; i < 2; ++i) {
+            unsigned p = epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+            for (int j = 0; j < SLOTS; ++j)
+                while (slots[j].cnt[p].load(std::memory_order_acquire))std::this_thread::yield();
+        }
+        for (int i = 0; i < nretired; ++i)tree::drop(retired[i]);
+        nretired = 0;
+    }
+
+    void publish(node *x) {
+        node *old = root.exchange(x, std::memory_order_seq_cst);
+        if (old == NULL)return;
+        retired[nretired++] = old;
+        if (nretired == RETIRE)synchronize();
+    }
+
+    /**
+     * the value of key copied into out, false if key is absent. lock-free.
+     */
+    bool find(const Key &key, T &out) const {
+        read_guard g(this);
+        node *x = tree::find(root.load(std::memory_order_seq_cst), key, comp());
+        if (x == NULL)return false;
+        out = x->val.second;
+        return true;
+    }
+
+    /**
+     * throw index_out_of_bound if key is absent.
+     */
+    T at(const Key &key) const {
+        read_guard g(this);
+        node *x = tree::find(root.load(std::memory_order_seq_cst), key, comp());
+        if (x == NULL)throw index_out_of_bound();
+        return x->val.second;
+    }
+
+    size_t count(const Key &key) const {
+        read_guard g(this);
+        return tree::find(root.load(std::memory_order_seq_cst), key, comp()) != NULL;
+    }
+
+    /**
+     * f(value) with the value of key, inside the read section, false if key is absent.
+     */
+    template<class F>
+    bool visit(const Key &key, F f) const {
+        read_guard g(this);
+        node *x = tree::find(root.load(std::memory_order_seq_cst), key, comp());
+        if (x == NULL)return false;
+        f(static_cast<const value_type &>(x->val));
+        return true;
+    }
+
+    /**
+     * f(value) for every element of one consistent version, in key order.
+     * the writer may retire further versions meanwhile but cannot free this one.
+     */
+    template<class F>
+    void for_each(F f) const {
+        read_guard g(this);
+        tree::for_each(root.load(std::memory_order_seq_cst), f);
+    }
+
+    size_t size() const { return sz.load(std::memory_order_relaxed); }
+
+    bool empty() const { return !size(); }
+
+    /**
+     * insert value if its key is absent, return whether it was inserted.
+     */
+    bool insert(const value_type &value) {
+        write_guard g(this);
+        node *r = root.load(std::memory_order_relaxed);
+        if (tree::find(r, value.first, comp()) != NULL)return false;
+        publish(tree::insert(r, value.first, comp(), value));
+        sz.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * set the value of key to t, inserting key if absent.
+     */
+    void insert_or_assign(const Key &key, const T &t) {
+        write_guard g(this);
+        node *r = root.load(std::memory_order_relaxed);
+        if (tree::find(r, key, comp()) != NULL)publish(tree::assign(r, key, comp(), t));
+        else {
+            publish(tree::insert(r, key, comp(), key, t));
+            sz.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * remove key, return the number of elements removed (0 or 1).
+     */
+    size_t erase(const Key &key) {
+        write_guard g(this);
+        node *r = root.load(std::memory_order_relaxed);
+        if (tree::find(r, key, comp()) == NULL)return 0;
+        publish(tree::erase(r, key, comp()));
+        sz.fetch_sub(1, std::memory_order_relaxed);
+        return 1;
+    }
+
+    void clear() {
+        write_guard g(this);
+        publish(NULL);
+        sz.store(0, std::memory_order_relaxed);
+        synchronize();
+    }
+
+    /**
+     * drop every retired version now instead of when RETIRE of them have piled up.
+     */
+    void reclaim() {
+        write_guard g(this);
+        synchronize();
+    }
+};
+
+}
+
+#endif
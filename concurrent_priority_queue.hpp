@@ -0,0 +1,246 @@
+#ifndef SJTU_CONCURRENT_PRIORITY_QUEUE_HPP
+#define SJTU_CONCURRENT_PRIORITY_QUEUE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include "exceptions.hpp"
+#include "priority_queue.hpp"
+
+namespace sjtu {
+
+/**
+ * a priority queue for many producer and consumer threads (a MultiQueue).
+ *
+ * the elements are spread over several shards, each a sjtu::priority_queue behind
+ * its own spinlock. push goes to a random shard whose lock is free. try_pop locks two
+ * random shards and pops the better of their tops, so it returns one of the best
+ * elements rather than the best: the order is relaxed, by about the number of
+ * shards, in exchange for threads almost never waiting on each other.
+ * each shard has its own node pool, so the system allocator is not contended either.
+ *
+ * whole heaps move in and out with the O(log n) merge of sjtu::priority_queue.
+ *
+ * pops drain the shards with good tops faster, so shard sizes drift apart until
+ * many picks land on empty shards. when try_pop holds two shards and one has over
+ * SKEW times the elements of the other (and at least SPLIT_MIN), it splits a subtree
+ * of the bigger heap off into the smaller one: O(k + log n) for k moved elements.
+ * since moved nodes make the shard pools share memory, each shard's free nodes are
+ * bounded by FREE (see priority_queue::set_max_free).
+ */
+template<typename T, class Compare = std::less<T>>
+class concurrent_priority_queue {
+public:
+    typedef priority_queue<T, Compare> heap;
+
+    enum {
+        SKEW = 4,
+        SPLIT_MIN = 64,
+        FREE = 1024
+    };
+
+    struct shard {
+        std::atomic_flag busy;
+        std::atomic<size_t> cnt;//size of q, readable without the lock
+        heap q;
+        unsigned char pad[64];//keeps the hot fields of neighbouring shards off one cache line
+
+        shard() : cnt(0) {
+            busy.clear();
+            q.set_max_free(FREE);
+        }
+
+        bool try_lock() {
+            return !busy.test_and_set(std::memory_order_acquire);
+        }
+
+        void lock() {
+            while (busy.test_and_set(std::memory_order_acquire))std::this_thread::yield();
+        }
+
+        void unlock() {
+            cnt.store(q.size(), std::memory_order_relaxed);
+            busy.clear(std::memory_order_release);
+        }
+    };
+
+    // unlocks a shard locked beforehand when it goes out of scope
+    class unlock_guard {
+    public:
+        shard *a;
+
+        explicit unlock_guard(shard *_a) : a(_a) {}
+
+        ~unlock_guard() {
+            a->unlock();
+        }
+    };
+
+    shard *s;
+    size_t n;
+    std::atomic<size_t> sz;
+
+    // a per-thread xorshift generator
+    static unsigned next_random() {
+        static std::atomic<unsigned> seed(0x9e3779b9u);
+        thread_local unsigned x = seed.fetch_add(0x6d2b79f5u, std::memory_order_relaxed) | 1;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    /**
+     * with shards == 0, two per hardware thread.
+     */
+    explicit concurrent_priority_queue(size_t shards = 0) : sz(0) {
+        if (!shards)shards = 2 * std::thread::hardware_concurrency();
+        n = shards < 2 ? 2 : shards;
+        s = new shard[n];
+    }
+
+    // shared between threads by reference, never copied
+    concurrent_priority_queue(const concurrent_priority_queue &) = delete;
+
+    concurrent_priority_queue &operator=(const concurrent_priority_queue &) = delete;
+
+    /**
+     * no other thread may be using the queue.
+     */
+    ~concurrent_priority_queue() {
+        delete[] s;
+    }
+
+    // a random shard, locked
+    shard *lock_any() {
+        for (;;) {
+            shard *a = s + next_random() % n;
+            if (a->try_lock())return a;
+        }
+    }
+
+    void push(const T &e) {
+        emplace(e);
+    }
+
+    void push(T &&e) {
+        emplace(std::move(e));
+    }
+
+    template<class... Args>
+    void emplace(Args &&... args) {
+        shard *a = lock_any();
+        try {
+            a->q.emplace(std::forward<Args>(args)...);
+        } catch (...) {
+            a->unlock();
+            throw;
+        }
+        sz.fetch_add(1, std::memory_order_relaxed);
+        a->unlock();
+    }
+
+    /**
+     * move every element of other into one shard in O(log n).
+     */
+    void merge(heap &other) {
+        size_t m = other.size();
+        shard *a = lock_any();
+        a->q.merge(other);
+        sz.fetch_add(m, std::memory_order_relaxed);
+        a->unlock();
+    }
+
+    // pop the top of the locked, nonempty shard a
+    T take(shard *a) {
+        T ret(a->q.pop_top());
+        sz.fetch_sub(1, std::memory_order_relaxed);
+        return ret;
+    }
+
+    // even out two locked shards whose sizes are far apart
+    static void rebalance(shard *a, shard *b) {
+        if (a->q.size() < b->q.size())std::swap(a, b);
+        if (a->q.size() < (size_t) SPLIT_MIN || a->q.size() <= (size_t) SKEW * b->q.size())return;
+        try {
+            a->q.split(b->q);
+        } catch (...) {}//out of memory: stay unbalanced
+    }
+
+    /**
+     * a nonempty shard with one of the best tops, locked, or NULL if the queue was found empty.
+     * after a few collisions or empty picks, every shard is tried in turn, so NULL
+     * means each shard was empty when it was looked at.
+     */
+    shard *lock_best() {
+        for (size_t k = 0; k < 2 * n; ++k) {
+            shard *a = s + next_random() % n, *b = s + next_random() % n;
+            if (!a->cnt.load(std::memory_order_relaxed))std::swap(a, b);
+            if (!a->cnt.load(std::memory_order_relaxed))continue;
+            if (!a->try_lock())continue;
+            if (b == a || !b->try_lock())b = NULL;//an empty b is still locked, to be rebalanced
+            shard *c = a;
+            if (b != NULL && !b->q.empty() && (a->q.empty() || Compare()(a->q.top(), b->q.top())))c = b;
+            if (b != NULL)rebalance(a, b);
+            if (c != a)a->unlock();
+            if (b != NULL && c != b)b->unlock();
+            if (!c->q.empty())return c;
+            c->unlock();
+        }
+        for (size_t i = 0; i < n; ++i) {
+            s[i].lock();
+            if (!s[i].q.empty())return s + i;
+            s[i].unlock();
+        }
+        return NULL;
+    }
+
+    /**
+     * pop one of the best elements into out, false if the queue was found empty.
+     */
+    bool try_pop(T &out) {
+        shard *c = lock_best();
+        if (c == NULL)return false;
+        unlock_guard g(c);
+        out = take(c);
+        return true;
+    }
+
+    /**
+     * pop one of the best elements.
+     * throw container_is_empty if the queue was found empty.
+     */
+    T pop() {
+        shard *c = lock_best();
+        if (c == NULL)throw container_is_empty();
+        unlock_guard g(c);
+        return take(c);
+    }
+
+    /**
+     * move every element into out, merging shard by shard, each in O(log n).
+     * elements pushed meanwhile may or may not be included.
+     */
+    void drain(heap &out) {
+        for (size_t i = 0; i < n; ++i) {
+            s[i].lock();
+            size_t m = s[i].q.size();
+            out.merge(s[i].q);
+            sz.fetch_sub(m, std::memory_order_relaxed);
+            s[i].unlock();
+        }
+    }
+
+    /**
+     * the number of elements; only a snapshot while other threads run.
+     */
+    size_t size() const { return sz.load(std::memory_order_relaxed); }
+
+    bool empty() const { return !size(); }
+};
+
+}
+
+#endif
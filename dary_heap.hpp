@@ -0,0 +1,186 @@
+#ifndef SJTU_DARY_HEAP_HPP
+#define SJTU_DARY_HEAP_HPP
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+ * a priority queue like sjtu::priority_queue kept as an implicit D-ary heap in one array.
+ *
+ * the children of a[i] are a[D * i + 1 .. D * i + D]. there is no per-element
+ * allocation, the array doubles when full, and with D = 4 or 8 the children of a
+ * node share a cache line, so the shallower tree costs fewer misses than the
+ * extra comparisons. merge is O(n + m) here instead of the leftist heap's O(log n),
+ * so prefer sjtu::priority_queue for queues that are merged often.
+ */
+template<typename T, class Compare = std::less<T>, int D = 4>
+class dary_heap {
+public:
+    T *a;
+    size_t n, cap;
+
+    dary_heap() : a(NULL), n(0), cap(0) {}
+
+    dary_heap(const dary_heap &other) : a(NULL), n(0), cap(0) {
+        reserve(other.n);
+        for (; n < other.n; ++n)new(a + n) T(other.a[n]);
+    }
+
+    dary_heap(dary_heap &&other) noexcept : a(other.a), n(other.n), cap(other.cap) {
+        other.a = NULL;
+        other.n = other.cap = 0;
+    }
+
+    void del() {
+        for (size_t i = 0; i < n; ++i)a[i].~T();
+        ::operator delete(a);
+        a = NULL;
+        n = cap = 0;
+    }
+
+    ~dary_heap() {
+        del();
+    }
+
+    dary_heap &operator=(const dary_heap &other) {
+        if (this == &other)return *this;
+        dary_heap tmp(other);
+        return *this = std::move(tmp);
+    }
+
+    dary_heap &operator=(dary_heap &&other) noexcept {
+        if (this == &other)return *this;
+        del();
+        a = other.a;
+        n = other.n;
+        cap = other.cap;
+        other.a = NULL;
+        other.n = other.cap = 0;
+        return *this;
+    }
+
+    /**
+     * room for c elements without growing.
+     */
+    void reserve(size_t c) {
+        if (c <= cap)return;
+        T *b = (T *) ::operator new(c * sizeof(T));
+        for (size_t i = 0; i < n; ++i) {
+            new(b + i) T(std::move(a[i]));
+            a[i].~T();
+        }
+        ::operator delete(a);
+        a = b;
+        cap = c;
+    }
+
+    // move v up from the hole at i, then into it
+    void sift_up(size_t i, T &v) {
+        while (i) {
+            size_t p = (i - 1) / D;
+            if (!Compare()(a[p], v))break;
+            a[i] = std::move(a[p]);
+            i = p;
+        }
+        a[i] = std::move(v);
+    }
+
+    // move v down from the hole at i among a[0, n), then into it
+    void sift_down(size_t i, T &v) {
+        for (;;) {
+            size_t c = D * i + 1;
+            if (c >= n)break;
+            size_t e = c + D < n ? c + D : n, b = c;
+            for (++c; c < e; ++c)if (Compare()(a[b], a[c]))b = c;
+            if (!Compare()(v, a[b]))break;
+            a[i] = std::move(a[b]);
+            i = b;
+        }
+        a[i] = std::move(v);
+    }
+
+    /**
+     * get the top of the queue.
+     * @return a reference of the top element.
+     * throw container_is_empty if empty() returns true;
+     */
+    const T &top() const {
+        if (empty())throw container_is_empty();
+        return a[0];
+    }
+
+    /**
+     * push new element to the priority queue.
+     */
+    void push(const T &e) {
+        emplace(e);
+    }
+
+    void push(T &&e) {
+        emplace(std::move(e));
+    }
+
+    // v is built before reserve can move the array, so args may refer into it (push(top()))
+    template<class... Args>
+    void emplace(Args &&... args) {
+        T v(std::forward<Args>(args)...);
+        if (n == cap)reserve(cap ? cap * 2 : 16);
+        if (!n || !Compare()(a[(n - 1) / D], v)) {
+            new(a + n++) T(std::move(v));
+            return;
+        }
+        // the parent moves into the raw slot at n and leaves its place as the hole
+        size_t p = (n - 1) / D;
+        new(a + n++) T(std::move(a[p]));
+        sift_up(p, v);
+    }
+
+    /**
+     * delete the top element.
+     * throw container_is_empty if empty() returns true;
+     */
+    void pop() {
+        if (empty())throw container_is_empty();
+        T v(std::move(a[--n]));
+        a[n].~T();
+        if (n)sift_down(0, v);
+    }
+
+    /**
+     * return the number of the elements.
+     */
+    size_t size() const {
+        return n;
+    }
+
+    /**
+     * check if the container has at least an element.
+     * @return true if it is empty, false if it has at least an element.
+     */
+    bool empty() const {
+        return !n;
+    }
+
+    /**
+     * move every element of other here and reheapify bottom-up, O(size() + other.size()).
+     */
+    void merge(dary_heap &other) {
+        if (this == &other || !other.n)return;
+        reserve(n + other.n);
+        for (size_t i = 0; i < other.n; ++i)new(a + n + i) T(std::move(other.a[i]));
+        n += other.n;
+        other.del();
+        for (size_t i = (n - 1) / D + 1; i--;) {
+            T v(std::move(a[i]));
+            sift_down(i, v);
+        }
+    }
+};
+
+}
+
+#endif
@@ -4,123 +4,317 @@
 #include "exceptions.hpp"
 
 #include <cstddef>
+#include <utility>
 #include <mcheck.h>
 
 namespace sjtu {
-const size_t S=500;
-template<class T>
+
+/**
+ * the default block capacity policy of sjtu::deque: a power of two close to sqrt(n),
+ * but a block never takes more than 256KB so that large elements do not produce huge blocks.
+ */
+struct sqrt_block {
+    static size_t block_size(size_t n, size_t elem) {
+        size_t c = 16, lim = (1 << 18) / elem;
+        while (c * c < n)c <<= 1;
+        while (c > 4 && c > lim)c >>= 1;
+        return c;
+    }
+};
+
+/**
+ * blocks of S elements whatever the size, the behaviour of the old global S = 500.
+ */
+template<size_t S>
+struct fixed_block {
+    static size_t block_size(size_t, size_t) {
+        return S;
+    }
+};
+
+template<class T, class Policy = sqrt_block>
 class deque {
 public:
-    struct node {
+    /**
+     * a block is a ring buffer holding at most cap elements,
+     * element k of the block lives in val[(st + k) % cap].
+     * HEAD and TAIL are sentinels with cap == 0.
+     * id is the index of the block in belong->dir, rk - belong->BASE the rank of its first element.
+     */
+    struct NODE {
         T *val;
-        node *pre, *nxt;
+        size_t cap, st, sz;
+        NODE *PRE, *NXT;
+        deque *belong;
+        size_t id, rk;
 
-        node() {
-            val = NULL;
-            pre = nxt = NULL;
+        NODE(NODE *_PRE = NULL, NODE *_NXT = NULL, size_t _cap = 0) : cap(_cap), st(0), sz(0), PRE(_PRE), NXT(_NXT) {
+            val = cap ? (T *) ::operator new(cap * sizeof(T)) : NULL;
         }
 
-        node(T _val, node *_pre = NULL, node *_nxt = NULL) : pre(_pre), nxt(_nxt) {
-            val = new T(_val);
+        NODE(const NODE &other) : cap(other.cap), st(0), sz(0) {
+            val = cap ? (T *) ::operator new(cap * sizeof(T)) : NULL;
+            for (; sz < other.sz; ++sz)new(val + sz) T(other[sz]);
+            PRE = NXT = NULL;
         }
 
-        ~node() {
-            if (val != NULL)delete val;
+        ~NODE() {
+            for (size_t i = 0; i < sz; ++i)(*this)[i].~T();
+            ::operator delete(val);
         }
 
-        bool check_head() const {
-            return pre == NULL;
+        T &operator[](size_t k) {
+            k += st;
+            return val[k < cap ? k : k - cap];
         }
 
-        bool check_tail() const {
-            return nxt == NULL;
+        const T &operator[](size_t k) const {
+            k += st;
+            return val[k < cap ? k : k - cap];
         }
-    };
 
-    struct NODE {
-        node *head, *tail;
-        size_t sz;
-        NODE *PRE, *NXT;
+        bool check_HEAD() const {
+            return PRE == NULL;
+        }
 
-        NODE(NODE *_PRE = NULL, NODE *_NXT = NULL, size_t _sz = 0) : PRE(_PRE), NXT(_NXT), sz(_sz) {
-            head = new node;
-            tail = new node;
-            head->nxt = tail;
-            tail->pre = head;
+        bool check_TAIL() const {
+            return NXT == NULL;
         }
 
-        NODE(const NODE &other) {
-            sz = other.sz;
-            node *p = head = new node, *q = other.head->nxt;
-            for (; q != other.tail; p = p->nxt, q = q->nxt) {
-                p->nxt = new node(*q->val, p);
-            }
-            p->nxt = tail = new node;
-            tail->pre = p;
-            PRE = NXT = NULL;
+        bool full() const {
+            return sz == cap;
         }
 
-        ~NODE() {
-            node *p = head, *q;
-            for (; p != tail; p = q) {
-                q = p->nxt;
-                delete p;
-            }
-            delete p;
+        size_t rank() const {
+            return rk - belong->BASE;
         }
 
-        bool check_HEAD() const {
-            return PRE == NULL;
+        bool PRE_size_inadequate() const {
+            return !PRE->check_HEAD() && PRE->sz + sz <= PRE->cap / 2;
         }
 
-        bool check_TAIL() const {
-            return NXT == NULL;
+        bool NXT_size_inadequate() const {
+            return !check_TAIL() && !NXT->check_TAIL() && NXT->sz + sz <= cap / 2;
         }
 
-        bool PRE_size_inadequate() const {
-            return !PRE->check_HEAD() && PRE->sz + sz <= S;
+        // move the element in slot from to the raw slot to
+        void relocate(size_t to, size_t from) {
+            new(&(*this)[to]) T(std::move((*this)[from]));
+            (*this)[from].~T();
         }
 
-        bool NXT_size_inadequate() const {
-            return !check_TAIL() && !NXT->check_TAIL() && NXT->sz + sz <= S;
-        }
-
-        void split(node *pp) {
-            node *tail1 = new node, *head2 = new node;
-            tail1->pre = pp->pre;
-            head2->nxt = pp;
-            pp->pre->nxt = tail1;
-            pp->pre = head2;
-            size_t sz1 = 0, sz2 = 0;
-            node *head1, *tail2;
-            for (head1 = tail1->pre; !head1->check_head(); head1 = head1->pre)++sz1;
-            for (tail2 = head2->nxt; !tail2->check_tail(); tail2 = tail2->nxt)++sz2;
-            NODE *preNODE = new NODE(PRE, this, sz1);
-            delete preNODE->head;delete preNODE->tail;
-            preNODE->head = head;
-            preNODE->tail = tail1;
-            head = head2;
-            sz = sz2;
-            PRE->NXT = preNODE;
-            PRE = preNODE;
+        // the block must not be full; shifts the shorter side
+        template<class V>
+        void Insert(size_t k, V &&x) {
+            if (&x >= val && &x < val + cap) {
+                T tmp(std::forward<V>(x));
+                Insert(k, std::move(tmp));
+                return;
+            }
+            if (k * 2 < sz) {
+                st = st ? st - 1 : cap - 1;
+                for (size_t i = 0; i < k; ++i)relocate(i, i + 1);
+            } else {
+                for (size_t i = sz; i > k; --i)relocate(i, i - 1);
+            }
+            new(&(*this)[k]) T(std::forward<V>(x));
+            ++sz;
+        }
+
+        void Erase(size_t k) {
+            (*this)[k].~T();
+            if (k * 2 < sz) {
+                for (size_t i = k; i > 0; --i)relocate(i, i - 1);
+                st = st + 1 == cap ? 0 : st + 1;
+            } else {
+                for (size_t i = k + 1; i < sz; ++i)relocate(i - 1, i);
+            }
+            --sz;
         }
 
+        // move the first k elements into a new block linked before this one
+        NODE *split(size_t k) {
+            NODE *p = belong->new_block(this);
+            for (; p->sz < k; ++p->sz) {
+                new(p->val + p->sz) T(std::move((*this)[p->sz]));
+                (*this)[p->sz].~T();
+            }
+            st = (st + k) % cap;
+            sz -= k;
+            rk += k;
+            return p;
+        }
+
+        // append all elements of NXT to this block and remove NXT
         void merge() {
-            tail->pre->nxt = NXT->head->nxt;
-            NXT->head->nxt->pre = tail->pre;
-            NXT->head->nxt = tail;
-            tail->pre = NXT->head;
-            std::swap(tail, NXT->tail);
-            sz += NXT->sz;
             NODE *p = NXT;
-            NXT->NXT->PRE = this;
-            NXT = NXT->NXT;
+            for (size_t i = 0; i < p->sz; ++i, ++sz) {
+                new(&(*this)[sz]) T(std::move((*p)[i]));
+                (*p)[i].~T();
+            }
+            p->sz = 0;
+            belong->dir_erase(p->id);
+            NXT = p->NXT;
+            NXT->PRE = this;
             delete p;
         }
     } *HEAD, *TAIL;
 
     size_t SZ;
 
+    /**
+     * block directory: dir[DL, DL + B) are the blocks in order and dir[DL + B] is TAIL,
+     * so the block holding a given rank is found by binary search on rk.
+     * there is spare room on both sides so that blocks are added at either end in O(1).
+     * ranks are stored offset by BASE: push_front/pop_front only move BASE and the
+     * first block, and Insert/Erase update the shorter side of the directory.
+     */
+    NODE **dir;
+    size_t DL, B, DCAP, BASE;
+
+    // reallocate the directory with the used part centered
+    void dir_grow() {
+        size_t cap = (B + 1) * 4 > DCAP ? DCAP * 2 : DCAP, l = (cap - B - 1) / 2;
+        NODE **tmp = new NODE *[cap];
+        for (size_t j = 0; j <= B; ++j)(tmp[l + j] = dir[DL + j])->id = l + j;
+        delete[] dir;
+        dir = tmp;
+        DCAP = cap;
+        DL = l;
+    }
+
+    // put p right before dir[i]
+    void dir_insert(size_t i, NODE *p) {
+        if (!DL || DL + B + 1 == DCAP) {
+            i -= DL;
+            dir_grow();
+            i += DL;
+        }
+        if (i - DL < DL + B - i) {
+            for (size_t j = --DL; j + 1 < i; ++j)(dir[j] = dir[j + 1])->id = j;
+            --i;
+        } else {
+            for (size_t j = DL + B + 1; j > i; --j)(dir[j] = dir[j - 1])->id = j;
+        }
+        (dir[i] = p)->id = i;
+        ++B;
+    }
+
+    void dir_erase(size_t i) {
+        if (i - DL < DL + B - i) {
+            for (; i > DL; --i)(dir[i] = dir[i - 1])->id = i;
+            ++DL;
+        } else {
+            for (; i < DL + B; ++i)(dir[i] = dir[i + 1])->id = i;
+        }
+        --B;
+    }
+
+    // rebuild the directory from the block list
+    void build_dir() {
+        B = 0;
+        for (NODE *p = HEAD->NXT; p != TAIL; p = p->NXT)++B;
+        DCAP = 16;
+        while (DCAP <= B * 2)DCAP *= 2;
+        dir = new NODE *[DCAP];
+        DL = (DCAP - B - 1) / 2;
+        BASE = 0;
+        size_t i = DL, r = 0;
+        for (NODE *p = HEAD->NXT;; p = p->NXT, ++i) {
+            dir[i] = p;
+            p->belong = this;
+            p->id = i;
+            p->rk = r;
+            r += p->sz;
+            if (p == TAIL)break;
+        }
+    }
+
+    // link a new empty block before p
+    NODE *new_block(NODE *p) {
+        NODE *q = new NODE(p->PRE, p, BLK);
+        p->PRE->NXT = q;
+        p->PRE = q;
+        q->belong = this;
+        q->rk = p->rk;
+        dir_insert(p->id, q);
+        return q;
+    }
+
+    // unlink an empty block
+    void remove_block(NODE *p) {
+        p->PRE->NXT = p->NXT;
+        p->NXT->PRE = p->PRE;
+        dir_erase(p->id);
+        delete p;
+    }
+
+    // element ranks changed by d after block p, done on the shorter side
+    void shift_rank(NODE *p, size_t d) {
+        if (p->id - DL < DL + B - p->id) {
+            for (size_t i = DL; i <= p->id; ++i)dir[i]->rk -= d;
+            BASE -= d;
+        } else {
+            for (size_t i = p->id + 1; i <= DL + B; ++i)dir[i]->rk += d;
+        }
+    }
+
+    /**
+     * block capacity, Policy::block_size(n, sizeof(T)) for n elements.
+     * the capacity is recomputed once the size has changed by a factor of 4.
+     * growing only affects blocks created afterwards, so push_back/push_front
+     * never relocate elements; shrinking rebuilds all blocks with the smaller
+     * capacity, at amortized O(1) cost per operation.
+     */
+    size_t BLK, GROW, SHRINK;
+
+    static size_t block_size(size_t n) {
+        return Policy::block_size(n, sizeof(T));
+    }
+
+    void set_threshold() {
+        GROW = SZ * 4 > BLK * BLK ? SZ * 4 : BLK * BLK;
+        SHRINK = SZ / 4;
+    }
+
+    void rebalance() {
+        size_t c = block_size(SZ);
+        if (c > BLK)BLK = c;
+        else if (c < BLK) {
+            BLK = c;
+            NODE *p = HEAD->NXT, *q = HEAD, *tmp;
+            for (; p != TAIL; p = tmp) {
+                for (size_t i = 0; i < p->sz; ++i, ++q->sz) {
+                    if (q->sz == q->cap) {
+                        q->NXT = new NODE(q, NULL, BLK);
+                        q = q->NXT;
+                    }
+                    new(&(*q)[q->sz]) T(std::move((*p)[i]));
+                    (*p)[i].~T();
+                }
+                p->sz = 0;
+                tmp = p->NXT;
+                delete p;
+            }
+            q->NXT = TAIL;
+            TAIL->PRE = q;
+            delete[] dir;
+            build_dir();
+        }
+        set_threshold();
+    }
+
+    // the block holding rank r, TAIL if r == SZ
+    NODE *locate(size_t r) const {
+        size_t l = DL, h = DL + B;
+        while (l < h) {
+            size_t m = (l + h + 1) >> 1;
+            if (dir[m]->rank() <= r)l = m;
+            else h = m - 1;
+        }
+        return dir[l];
+    }
+
     class const_iterator;
 
     class iterator {
@@ -128,9 +322,9 @@ public:
     private:
     public:
         NODE *CUR;
-        node *cur;
+        size_t idx;
 
-        iterator(NODE *_CUR = NULL, node *_cur = NULL) : CUR(_CUR), cur(_cur) {}
+        iterator(NODE *_CUR = NULL, size_t _idx = 0) : CUR(_CUR), idx(_idx) {}
 
         /**
          * return a new iterator which pointer n-next elements
@@ -138,96 +332,58 @@ public:
          * as well as operator-
          */
         bool check_invalid() const {
-            return cur == NULL;
+            return CUR == NULL;
         }
 
         iterator operator+(const int &n) const {
-            if (check_invalid())throw invalid_iterator();
-            if (!n)return *this;
-            if (n < 0)return *this - (-n);
             iterator ret = *this;
-            int k = n;
-            while (k && !ret.cur->check_tail())--k, ret.cur = ret.cur->nxt;
-            if (!ret.cur->check_tail())return ret;
-            while (!ret.CUR->check_TAIL()) {
-                ret.CUR = ret.CUR->NXT;
-                if (ret.CUR->check_TAIL() || ret.CUR->sz > k)break;
-                k -= ret.CUR->sz;
-            }
-            if (ret.CUR->check_TAIL() && k)ret.cur = NULL;
-            else for (ret.cur = ret.CUR->head; k >= 0; --k)ret.cur = ret.cur->nxt;
-            return ret;
+            return ret += n;
         }
 
         iterator operator-(const int &n) const {
-            if (check_invalid())throw invalid_iterator();
-            if (!n)return *this;
-            if (n < 0)return *this + (-n);
             iterator ret = *this;
-            int k = n;
-            while (k && !ret.cur->check_head())--k, ret.cur = ret.cur->pre;
-            if (!ret.cur->check_head())return ret;
-            while (1) {
-                ret.CUR = ret.CUR->PRE;
-                if (ret.CUR->check_HEAD() || ret.CUR->sz > k)break;
-                k -= ret.CUR->sz;
-            }
-            if (ret.CUR->check_HEAD())ret.cur = NULL;
-            else for (ret.cur = ret.CUR->tail; k >= 0; --k)ret.cur = ret.cur->pre;
-            return ret;
+            return ret -= n;
         }
 
         // return th distance between two iterator,
         // if these two iterators points to different vectors, throw invaild_iterator.
         int operator-(const iterator &rhs) const {
             if (check_invalid() || rhs.check_invalid())throw invalid_iterator();
-            iterator p = *this, q = rhs;
-            int cntp = 0, cntq = 0;
-            while (!p.cur->check_tail())p.cur = p.cur->nxt, ++cntp;
-            while (!p.CUR->check_TAIL()) {
-                p.CUR = p.CUR->NXT;
-                cntp += p.CUR->sz;
-            }
-            while (!q.cur->check_tail())q.cur = q.cur->nxt, ++cntq;
-            while (!q.CUR->check_TAIL()) {
-                q.CUR = q.CUR->NXT;
-                cntq += q.CUR->sz;
-            }
-            if (p.CUR != q.CUR)throw invalid_iterator();
-            return cntq - cntp;
+            if (CUR->belong != rhs.CUR->belong)throw invalid_iterator();
+            return (int) (CUR->rk + idx - rhs.CUR->rk - rhs.idx);
         }
 
         iterator &operator+=(const int &n) {
             if (check_invalid())throw invalid_iterator();
-            if (!n)return *this;
             if (n < 0) return *this -= (-n);
-            int k = n;
-            while (k && !cur->check_tail())--k, cur = cur->nxt;
-            if (!cur->check_tail())return *this;
-            while (!CUR->check_TAIL()) {
-                CUR = CUR->NXT;
-                if (CUR->check_TAIL() || CUR->sz > k)break;
-                k -= CUR->sz;
+            if (idx + n < CUR->sz) {
+                idx += n;
+                return *this;
             }
-            if (CUR->check_TAIL() && k)cur = NULL;
-            else for (cur = CUR->head; k >= 0; --k)cur = cur->nxt;
+            size_t r = CUR->rank() + idx + n;
+            if (r > CUR->belong->SZ) {
+                CUR = NULL;
+                return *this;
+            }
+            CUR = CUR->belong->locate(r);
+            idx = r - CUR->rank();
             return *this;
         }
 
         iterator &operator-=(const int &n) {
             if (check_invalid())throw invalid_iterator();
             if (n < 0)return *this += -n;
-            if (!n)return *this;
-            int k = n;
-            while (k && !cur->check_head())--k, cur = cur->pre;
-            if (!cur->check_head())return *this;
-            while (1) {
-                CUR = CUR->PRE;
-                if (CUR->check_HEAD() || CUR->sz > k)break;
-                k -= CUR->sz;
+            if ((size_t) n <= idx) {
+                idx -= n;
+                return *this;
+            }
+            if ((size_t) n > CUR->rank() + idx) {
+                CUR = NULL;
+                return *this;
             }
-            if (CUR->check_HEAD())cur = NULL;
-            else for (cur = CUR->tail; k >= 0; --k)cur = cur->pre;
+            size_t r = CUR->rank() + idx - n;
+            CUR = CUR->belong->locate(r);
+            idx = r - CUR->rank();
             return *this;
         }
 
@@ -274,7 +430,7 @@ public:
          */
         T &operator*() const {
             if (check_invalid() || CUR->check_TAIL())throw invalid_iterator();
-            return *cur->val;
+            return (*CUR)[idx];
         }
 
         /**
@@ -282,29 +438,29 @@ public:
          */
         T *operator->() const {
             if (check_invalid() || CUR->check_TAIL())throw invalid_iterator();
-            return cur->val;
+            return &(*CUR)[idx];
         }
 
         /**
          * a operator to check whether two iterators are same (pointing to the same memory).
          */
         bool operator==(const iterator &rhs) const {
-            return CUR == rhs.CUR && cur == rhs.cur;
+            return CUR == rhs.CUR && idx == rhs.idx;
         }
 
         bool operator==(const const_iterator &rhs) const {
-            return CUR == rhs.CUR && cur == rhs.cur;
+            return CUR == rhs.CUR && idx == rhs.idx;
         }
 
         /**
          * some other operator for iterator.
          */
         bool operator!=(const iterator &rhs) const {
-            return CUR != rhs.CUR || cur != rhs.cur;
+            return CUR != rhs.CUR || idx != rhs.idx;
         }
 
         bool operator!=(const const_iterator &rhs) const {
-            return CUR != rhs.CUR || cur != rhs.cur;
+            return CUR != rhs.CUR || idx != rhs.idx;
         }
     };
 
@@ -314,105 +470,67 @@ public:
     private:// data members.
     public:
         NODE *CUR;
-        node *cur;
+        size_t idx;
 
-        const_iterator(NODE *_CUR = NULL, node *_cur = NULL) : CUR(_CUR), cur(_cur) {}
+        const_iterator(NODE *_CUR = NULL, size_t _idx = 0) : CUR(_CUR), idx(_idx) {}
 
-        const_iterator(const const_iterator &other) : CUR(other.CUR), cur(other.cur) {}
+        const_iterator(const const_iterator &other) : CUR(other.CUR), idx(other.idx) {}
 
-        const_iterator(const iterator &other) : CUR(other.CUR), cur(other.cur) {}
+        const_iterator(const iterator &other) : CUR(other.CUR), idx(other.idx) {}
 
         bool check_invalid() const {
-            return cur == NULL;
+            return CUR == NULL;
         }
 
         const_iterator operator+(const int &n) const {
-            if (check_invalid())throw invalid_iterator();
-            if (!n)return *this;
-            if (n < 0)return *this - (-n);
             const_iterator ret = *this;
-            int k = n;
-            while (k && !ret.cur->check_tail())--k, ret.cur = ret.cur->nxt;
-            if (!ret.cur->check_tail())return ret;
-            while (!ret.CUR->check_TAIL()) {
-                ret.CUR = ret.CUR->NXT;
-                if (ret.CUR->check_TAIL() || ret.CUR->sz > k)break;
-                k -= ret.CUR->sz;
-            }
-            if (ret.CUR->check_TAIL() && k)ret.cur = NULL;
-            else for (ret.cur = ret.CUR->head; k >= 0; --k)ret.cur = ret.cur->nxt;
-            return ret;
+            return ret += n;
         }
 
         const_iterator operator-(const int &n) const {
-            if (check_invalid())throw invalid_iterator();
-            if (!n)return *this;
-            if (n < 0)return *this + (-n);
             const_iterator ret = *this;
-            int k = n;
-            while (k && !ret.cur->check_head())--k, ret.cur = ret.cur->pre;
-            if (!ret.cur->check_head())return ret;
-            while (1) {
-                ret.CUR = ret.CUR->PRE;
-                if (ret.CUR->check_HEAD() || ret.CUR->sz > k)break;
-                k -= ret.CUR->sz;
-            }
-            if (ret.CUR->check_HEAD())ret.cur = NULL;
-            else for (ret.cur = ret.CUR->tail; k >= 0; --k)ret.cur = ret.cur->pre;
-            return ret;
+            return ret -= n;
         }
 
         // return th distance between two const_iterator,
         // if these two const_iterators points to different vectors, throw invaild_iterator.
         int operator-(const const_iterator &rhs) const {
             if (check_invalid() || rhs.check_invalid())throw invalid_iterator();
-            const_iterator p = *this, q = rhs;
-            int cntp = 0, cntq = 0;
-            while (!p.cur->check_tail())p.cur = p.cur->nxt, ++cntp;
-            while (!p.CUR->check_TAIL()) {
-                p.CUR = p.CUR->NXT;
-                cntp += p.CUR->sz;
-            }
-            while (!q.cur->check_tail())q.cur = q.cur->nxt, ++cntq;
-            while (!q.CUR->check_TAIL()) {
-                q.CUR = q.CUR->NXT;
-                cntq += q.CUR->sz;
-            }
-            if (p.CUR != q.CUR)throw invalid_iterator();
-            return cntq - cntp;
+            if (CUR->belong != rhs.CUR->belong)throw invalid_iterator();
+            return (int) (CUR->rk + idx - rhs.CUR->rk - rhs.idx);
         }
 
         const_iterator &operator+=(const int &n) {
             if (check_invalid())throw invalid_iterator();
-            if (!n)return *this;
             if (n < 0) return *this -= (-n);
-            int k = n;
-            while (k && !cur->check_tail())--k, cur = cur->nxt;
-            if (!cur->check_tail())return *this;
-            while (!CUR->check_TAIL()) {
-                CUR = CUR->NXT;
-                if (CUR->check_TAIL() || CUR->sz > k)break;
-                k -= CUR->sz;
+            if (idx + n < CUR->sz) {
+                idx += n;
+                return *this;
+            }
+            size_t r = CUR->rank() + idx + n;
+            if (r > CUR->belong->SZ) {
+                CUR = NULL;
+                return *this;
             }
-            if (CUR->check_TAIL() && k)cur = NULL;
-            else for (cur = CUR->head; k >= 0; --k)cur = cur->nxt;
+            CUR = CUR->belong->locate(r);
+            idx = r - CUR->rank();
             return *this;
         }
 
         const_iterator &operator-=(const int &n) {
             if (check_invalid())throw invalid_iterator();
             if (n < 0)return *this += -n;
-            if (!n)return *this;
-            int k = n;
-            while (k && !cur->check_head())--k, cur = cur->pre;
-            if (!cur->check_head())return *this;
-            while (1) {
-                CUR = CUR->PRE;
-                if (CUR->check_HEAD() || CUR->sz > k)break;
-                k -= CUR->sz;
+            if ((size_t) n <= idx) {
+                idx -= n;
+                return *this;
             }
-            if (CUR->check_HEAD())cur = NULL;
-            else for (cur = CUR->tail; k >= 0; --k)cur = cur->pre;
+            if ((size_t) n > CUR->rank() + idx) {
+                CUR = NULL;
+                return *this;
+            }
+            size_t r = CUR->rank() + idx - n;
+            CUR = CUR->belong->locate(r);
+            idx = r - CUR->rank();
             return *this;
         }
 
@@ -459,7 +577,7 @@ public:
          */
         const T &operator*() const {
             if (check_invalid() || CUR->check_TAIL())throw invalid_iterator();
-            return *cur->val;
+            return (*CUR)[idx];
         }
 
         /**
@@ -467,44 +585,49 @@ public:
          */
         const T *operator->() const {
             if (check_invalid() || CUR->check_TAIL())throw invalid_iterator();
-            return cur->val;
+            return &(*CUR)[idx];
         }
 
         /**
          * a operator to check whether two iterators are same (pointing to the same memory).
          */
         bool operator==(const const_iterator &rhs) const {
-            return CUR == rhs.CUR && cur == rhs.cur;
+            return CUR == rhs.CUR && idx == rhs.idx;
         }
 
         bool operator==(const iterator &rhs) const {
-            return CUR == rhs.CUR && cur == rhs.cur;
+            return CUR == rhs.CUR && idx == rhs.idx;
         }
 
         /**
          * some other operator for iterator.
          */
         bool operator!=(const const_iterator &rhs) const {
-            return CUR != rhs.CUR || cur != rhs.cur;
+            return CUR != rhs.CUR || idx != rhs.idx;
         }
 
         bool operator!=(const iterator &rhs) const {
-            return CUR != rhs.CUR || cur != rhs.cur;
+            return CUR != rhs.CUR || idx != rhs.idx;
         }
     };
 
-    /**
-     * TODO Constructors
-     */
-    deque() {
+    // a moved-from deque has no sentinels, they are recreated on demand
+    void init() {
         HEAD = new NODE;
         TAIL = new NODE;
         SZ = 0;
         HEAD->NXT = TAIL;
         TAIL->PRE = HEAD;
+        build_dir();
+        BLK = block_size(0);
+        set_threshold();
     }
 
-    deque(const deque &other) {
+    void copy(const deque &other) {
+        if (other.HEAD == NULL) {
+            init();
+            return;
+        }
         NODE *p = HEAD = new NODE, *q = other.HEAD;
         SZ = other.SZ;
         for (; q != other.TAIL; p = p->NXT, q = q->NXT) {
@@ -512,18 +635,61 @@ public:
             p->NXT->PRE = p;
         }
         TAIL = p;
+        build_dir();
+        BLK = other.BLK;
+        GROW = other.GROW;
+        SHRINK = other.SHRINK;
     }
 
-    /**
-     * TODO Deconstructor
-     */
-    ~deque() {
+    void del() {
+        if (HEAD == NULL)return;
         NODE *p = HEAD, *q;
         for (; p != TAIL; p = q) {
             q = p->NXT;
             delete p;
         }
         delete p;
+        delete[] dir;
+    }
+
+    void steal(deque &other) noexcept {
+        HEAD = other.HEAD;
+        TAIL = other.TAIL;
+        SZ = other.SZ;
+        dir = other.dir;
+        DL = other.DL;
+        B = other.B;
+        DCAP = other.DCAP;
+        BASE = other.BASE;
+        BLK = other.BLK;
+        GROW = other.GROW;
+        SHRINK = other.SHRINK;
+        if (HEAD != NULL)for (size_t i = DL; i <= DL + B; ++i)dir[i]->belong = this;
+        other.HEAD = other.TAIL = NULL;
+        other.dir = NULL;
+        other.SZ = 0;
+    }
+
+    /**
+     * TODO Constructors
+     */
+    deque() {
+        init();
+    }
+
+    deque(const deque &other) {
+        copy(other);
+    }
+
+    deque(deque &&other) noexcept {
+        steal(other);
+    }
+
+    /**
+     * TODO Deconstructor
+     */
+    ~deque() {
+        del();
     }
 
     /**
@@ -531,21 +697,15 @@ public:
      */
     deque &operator=(const deque &other) {
         if (this == &other)return *this;
-        NODE *p = HEAD, *q;
-        //del
-        for (; p != TAIL; p = q) {
-            q = p->NXT;
-            delete p;
-        }
-        delete p;
-        //copy
-        p = HEAD = new NODE;
-        for (q = other.HEAD; q != other.TAIL; p = p->NXT, q = q->NXT) {
-            p->NXT = new NODE(*(q->NXT));
-            p->NXT->PRE = p;
-        }
-        TAIL = p;
-        SZ = other.SZ;
+        del();
+        copy(other);
+        return *this;
+    }
+
+    deque &operator=(deque &&other) noexcept {
+        if (this == &other)return *this;
+        del();
+        steal(other);
         return *this;
     }
 
@@ -555,54 +715,22 @@ public:
      */
     T &at(const size_t &pos) {
         if (pos < 0 || pos >= SZ) throw index_out_of_bound();
-        NODE *p = HEAD->NXT;
-        size_t k = pos;
-        while (!p->check_TAIL() && p->sz <= k) {
-            k -= p->sz;
-            p = p->NXT;
-        }
-        node *pp = p->head->nxt;
-        while (k--)pp = pp->nxt;
-        return *pp->val;
+        NODE *p = locate(pos);
+        return (*p)[pos - p->rank()];
     }
 
     const T &at(const size_t &pos) const {
         if (pos < 0 || pos >= SZ) throw index_out_of_bound();
-        NODE *p = HEAD->NXT;
-        size_t k = pos;
-        while (!p->check_TAIL() && p->sz <= k) {
-            k -= p->sz;
-            p = p->NXT;
-        }
-        node *pp = p->head->nxt;
-        while (k--)pp = pp->nxt;
-        return *pp->val;
+        NODE *p = locate(pos);
+        return (*p)[pos - p->rank()];
     }
 
     T &operator[](const size_t &pos) {
-        if (pos < 0 || pos >= SZ) throw index_out_of_bound();
-        NODE *p = HEAD->NXT;
-        size_t k = pos;
-        while (!p->check_TAIL() && p->sz <= k) {
-            k -= p->sz;
-            p = p->NXT;
-        }
-        node *pp = p->head->nxt;
-        while (k--)pp = pp->nxt;
-        return *pp->val;
+        return at(pos);
     }
 
     const T &operator[](const size_t &pos) const {
-        if (pos < 0 || pos >= SZ) throw index_out_of_bound();
-        NODE *p = HEAD->NXT;
-        size_t k = pos;
-        while (!p->check_TAIL() && p->sz <= k) {
-            k -= p->sz;
-            p = p->NXT;
-        }
-        node *pp = p->head->nxt;
-        while (k--)pp = pp->nxt;
-        return *pp->val;
+        return at(pos);
     }
 
     /**
@@ -611,7 +739,7 @@ public:
      */
     const T &front() const {
         if (empty())throw container_is_empty();
-        return *HEAD->NXT->head->nxt->val;
+        return (*HEAD->NXT)[0];
     }
 
     /**
@@ -620,35 +748,39 @@ public:
      */
     const T &back() const {
         if (empty())throw container_is_empty();
-        return *TAIL->PRE->tail->pre->val;
+        return (*TAIL->PRE)[TAIL->PRE->sz - 1];
     }
 
     /**
      * returns an iterator to the beginning.
      */
     iterator begin() {
-        return iterator(HEAD->NXT, HEAD->NXT->head->nxt);
+        if (HEAD == NULL)init();
+        return iterator(HEAD->NXT, 0);
     }
 
     const_iterator cbegin() const {
-        return const_iterator(HEAD->NXT, HEAD->NXT->head->nxt);
+        if (HEAD == NULL)return const_iterator();
+        return const_iterator(HEAD->NXT, 0);
     }
 
     /**
      * returns an iterator to the end.
      */
     iterator end() {
-        return iterator(TAIL, TAIL->tail);
+        if (HEAD == NULL)init();
+        return iterator(TAIL, 0);
     }
 
     const_iterator cend() const {
-        return const_iterator(TAIL, TAIL->tail);
+        if (HEAD == NULL)return const_iterator();
+        return const_iterator(TAIL, 0);
     }
 
     /**
      * checks whether the container is empty.
      */
-    bool empty() const { return HEAD->NXT == TAIL; }
+    bool empty() const { return !SZ; }
 
     /**
      * returns the number of elements
@@ -659,6 +791,7 @@ public:
      * clears the contents
      */
     void clear() {
+        if (HEAD == NULL)return;
         NODE *p = HEAD->NXT, *q;
         for (; p != TAIL; p = q) {
             q = p->NXT;
@@ -667,6 +800,12 @@ public:
         HEAD->NXT = TAIL;
         TAIL->PRE = HEAD;
         SZ = 0;
+        B = BASE = 0;
+        dir[DL] = TAIL;
+        TAIL->id = DL;
+        TAIL->rk = 0;
+        BLK = block_size(0);
+        set_threshold();
     }
 
     /**
@@ -676,29 +815,56 @@ public:
      *     throw if the iterator is invalid or it point to a wrong place.
      */
 
-    iterator Insert(iterator pos, const T &value) {
+    template<class V>
+    iterator Insert(iterator pos, V &&value) {
+        NODE *p = pos.CUR;
+        size_t k = pos.idx;
+        if (!k && !p->PRE->check_HEAD() && !p->PRE->full()) {
+            p = p->PRE;
+            k = p->sz;
+        } else if (p->check_TAIL()) {
+            p = new_block(TAIL);
+        } else if (p->full()) {
+            if (&value >= p->val && &value < p->val + p->cap) {//split would move value away
+                T tmp(std::forward<V>(value));
+                return Insert(pos, std::move(tmp));
+            }
+            size_t h = p->cap / 2;
+            NODE *q = p->split(h);
+            if (k <= h)p = q;
+            else k -= h;
+        }
+        p->Insert(k, std::forward<V>(value));
+        shift_rank(p, 1);
         ++SZ;
-        node *pp = new node(value, pos.cur->pre, pos.cur);
-        pos.cur->pre->nxt = pp;
-        pos.cur->pre = pp;
-        if (++pos.CUR->sz <= S && !pos.cur->check_tail()) {
-            return iterator(pos.CUR, pp);
+        if (SZ > GROW) {
+            size_t r = p->rank() + k;
+            rebalance();
+            p = locate(r);
+            k = r - p->rank();
         }
-        pos.CUR->split(pos.cur);
-        if (pos.CUR->PRE->PRE_size_inadequate()) {
-            pos.CUR->PRE->PRE->merge();
-        } else if (pos.CUR->NXT_size_inadequate())pos.CUR->merge();
-        return pos - 1;
+        return iterator(p, k);
     }
 
     iterator insert(iterator pos, const T &value) {
-        if (pos.check_invalid())throw invalid_iterator();
-        NODE *p = pos.CUR;
-        while (!p->check_TAIL())p = p->NXT;
-        if (p != TAIL)throw invalid_iterator();
+        if (pos.check_invalid() || pos.CUR->belong != this || pos.idx > pos.CUR->sz)throw invalid_iterator();
         return Insert(pos, value);
     }
 
+    iterator insert(iterator pos, T &&value) {
+        if (pos.check_invalid() || pos.CUR->belong != this || pos.idx > pos.CUR->sz)throw invalid_iterator();
+        return Insert(pos, std::move(value));
+    }
+
+    /**
+     * constructs the element before pos from args.
+     */
+    template<class... Args>
+    iterator emplace(iterator pos, Args &&... args) {
+        if (pos.check_invalid() || pos.CUR->belong != this || pos.idx > pos.CUR->sz)throw invalid_iterator();
+        return Insert(pos, T(std::forward<Args>(args)...));
+    }
+
     /**
      * removes specified element at pos.
      * removes the element at pos.
@@ -707,27 +873,38 @@ public:
      */
     iterator Erase(iterator pos) {
         --SZ;
-        iterator ret = pos + 1;
-        pos.cur->nxt->pre = pos.cur->pre;
-        pos.cur->pre->nxt = pos.cur->nxt;
-        delete pos.cur;
-        --pos.CUR->sz;
-        if (pos.CUR->PRE_size_inadequate()) {
-            if (pos.CUR == ret.CUR)ret.CUR = ret.CUR->PRE;
-            pos.CUR->PRE->merge();
-        } else if (pos.CUR->NXT_size_inadequate()) {
-            ret.CUR = pos.CUR;
-            pos.CUR->merge();
-        }
-        if (!SZ)clear();
-        return ret;
+        NODE *p = pos.CUR;
+        size_t k = pos.idx;
+        p->Erase(k);
+        shift_rank(p, -1);
+        if (!p->sz) {
+            NODE *q = p->NXT;
+            remove_block(p);
+            if (SZ < SHRINK) {
+                size_t r = q->rank();
+                rebalance();
+                q = locate(r);
+                return iterator(q, r - q->rank());
+            }
+            return iterator(q, 0);
+        }
+        if (p->PRE_size_inadequate()) {
+            p = p->PRE;
+            k += p->sz;
+            p->merge();
+        } else if (p->NXT_size_inadequate())p->merge();
+        if (SZ < SHRINK) {
+            size_t r = p->rank() + k;
+            rebalance();
+            p = locate(r);
+            k = r - p->rank();
+        }
+        if (k == p->sz)return iterator(p->NXT, 0);
+        return iterator(p, k);
     }
 
     iterator erase(iterator pos) {
-        if (pos.check_invalid() || pos.CUR->check_TAIL())throw invalid_iterator();
-        NODE *p = pos.CUR;
-        while (!p->check_TAIL())p = p->NXT;
-        if (p != TAIL)throw invalid_iterator();
+        if (pos.check_invalid() || pos.CUR->belong != this || pos.idx >= pos.CUR->sz)throw invalid_iterator();
         return Erase(pos);
     }
 
@@ -735,7 +912,22 @@ public:
      * adds an element to the end
      */
     void push_back(const T &value) {
-        Insert(end(), value);
+        emplace_back(value);
+    }
+
+    void push_back(T &&value) {
+        emplace_back(std::move(value));
+    }
+
+    template<class... Args>
+    void emplace_back(Args &&... args) {
+        if (HEAD == NULL)init();
+        NODE *p = TAIL->PRE;
+        if (p->check_HEAD() || p->full())p = new_block(TAIL);
+        new(&(*p)[p->sz]) T(std::forward<Args>(args)...);
+        ++p->sz;
+        ++TAIL->rk;
+        if (++SZ > GROW)rebalance();
     }
 
     /**
@@ -744,14 +936,36 @@ public:
      */
     void pop_back() {
         if (empty())throw invalid_iterator();
-        Erase(end() - 1);
+        NODE *p = TAIL->PRE;
+        (*p)[--p->sz].~T();
+        --TAIL->rk;
+        if (!p->sz)remove_block(p);
+        if (--SZ < SHRINK)rebalance();
     }
 
     /**
      * inserts an element to the beginning.
      */
     void push_front(const T &value) {
-        Insert(begin(), value);
+        emplace_front(value);
+    }
+
+    void push_front(T &&value) {
+        emplace_front(std::move(value));
+    }
+
+    template<class... Args>
+    void emplace_front(Args &&... args) {
+        if (HEAD == NULL)init();
+        NODE *p = HEAD->NXT;
+        if (p->check_TAIL() || p->full())p = new_block(p);
+        size_t s = p->st ? p->st - 1 : p->cap - 1;
+        new(p->val + s) T(std::forward<Args>(args)...);
+        p->st = s;
+        ++p->sz;
+        --p->rk;
+        --BASE;
+        if (++SZ > GROW)rebalance();
     }
 
     /**
@@ -760,7 +974,14 @@ public:
      */
     void pop_front() {
         if (empty())throw invalid_iterator();
-        Erase(begin());
+        NODE *p = HEAD->NXT;
+        (*p)[0].~T();
+        p->st = p->st + 1 == p->cap ? 0 : p->st + 1;
+        --p->sz;
+        ++p->rk;
+        ++BASE;
+        if (!p->sz)remove_block(p);
+        if (--SZ < SHRINK)rebalance();
     }
 };
 
@@ -0,0 +1,534 @@
+#ifndef SJTU_FLAT_MAP_HPP
+#define SJTU_FLAT_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <utility>
+#include "utility.hpp"
+#include "compare_base.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+ * an ordered map with the interface of sjtu::map, kept as two parallel sorted
+ * arrays: the keys, searched by a branch-free binary search, and the mapped values.
+ * a small map is then a few cache lines with no per-element overhead, and each
+ * key is stored once.
+ *
+ * since no value_type is stored, iterators yield a pair<const Key &, T &> of
+ * references into the two arrays (convertible to value_type), and operator->
+ * goes through a proxy holding that pair. bind *it by value or const reference.
+ *
+ * insert and erase shift the arrays, O(n) each, so they invalidate iterators.
+ * for bursts of writes, defer_insert appends to an unsorted buffer that is
+ * sorted and merged in one O(n + k log k) pass by the next lookup or iteration.
+ * because of that merge, const lookups are not safe to run concurrently
+ * after defer_insert unless one of them has been called (or flush()) first.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>
+> class flat_map : public compare_base<Compare> {
+public:
+    typedef pair<const Key, T> value_type;
+    typedef pair<const Key &, T &> reference;
+    typedef pair<const Key &, const T &> const_reference;
+
+    mutable Key *keys;
+    mutable T *vals;//vals[i] is mapped to keys[i]
+    mutable size_t n, cap;
+    mutable value_type *pend;//deferred insertions, in arrival order
+    mutable size_t np, pcap;
+
+    using compare_base<Compare>::comp;
+
+    template<class V>
+    static void relocate(V *to, V *from) {
+        new(to) V(std::move(*from));
+        from->~V();
+    }
+
+    // what operator-> of an iterator returns, keeping the pair of references alive
+    template<class R>
+    class arrow_proxy {
+    public:
+        R r;
+
+        const R *operator->() const { return &r; }
+    };
+
+    // move a[n] down to a[i], shifting a[i, n) right
+    template<class V>
+    static void rotate_in(V *a, size_t i, size_t n) {
+        if (i == n)return;
+        alignas(V) unsigned char buf[sizeof(V)];
+        V *tmp = (V *) buf;
+        relocate(tmp, a + n);
+        for (size_t j = n; j > i; --j)relocate(a + j, a + j - 1);
+        relocate(a + i, tmp);
+    }
+
+    class const_iterator;
+
+    class iterator {
+    private:
+    public:
+        flat_map *belong;
+        size_t idx;
+
+        bool check_invalid() const { return belong == NULL; }
+
+        bool check_end() const { return idx >= belong->n; }
+
+        iterator(flat_map *_belong = NULL, size_t _idx = 0) : belong(_belong), idx(_idx) {}
+
+        iterator operator++(int) {
+            iterator ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        iterator &operator++() {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            ++idx;
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator ret(*this);
+            --*this;
+            return ret;
+        }
+
+        iterator &operator--() {
+            if (check_invalid() || !idx)throw invalid_iterator();
+            --idx;
+            return *this;
+        }
+
+        reference operator*() const {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            return reference(belong->keys[idx], belong->vals[idx]);
+        }
+
+        bool operator==(const iterator &rhs) const { return belong == rhs.belong && idx == rhs.idx; }
+
+        bool operator==(const const_iterator &rhs) const { return belong == rhs.belong && idx == rhs.idx; }
+
+        bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+
+        bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+
+        arrow_proxy<reference> operator->() const noexcept {
+            return arrow_proxy<reference>{reference(belong->keys[idx], belong->vals[idx])};
+        }
+    };
+
+    class const_iterator {
+    private:
+    public:
+        const flat_map *belong;
+        size_t idx;
+
+        bool check_invalid() const { return belong == NULL; }
+
+        bool check_end() const { return idx >= belong->n; }
+
+        const_iterator(const flat_map *_belong = NULL, size_t _idx = 0) : belong(_belong), idx(_idx) {}
+
+        const_iterator(const iterator &other) : belong(other.belong), idx(other.idx) {}
+
+        const_iterator operator++(int) {
+            const_iterator ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        const_iterator &operator++() {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            ++idx;
+            return *this;
+        }
+
+        const_iterator operator--(int) {
+            const_iterator ret(*this);
+            --*this;
+            return ret;
+        }
+
+        const_iterator &operator--() {
+            if (check_invalid() || !idx)throw invalid_iterator();
+            --idx;
+            return *this;
+        }
+
+        const_reference operator*() const {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            return const_reference(belong->keys[idx], belong->vals[idx]);
+        }
+
+        bool operator==(const const_iterator &rhs) const { return belong == rhs.belong && idx == rhs.idx; }
+
+        bool operator==(const iterator &rhs) const { return belong == rhs.belong && idx == rhs.idx; }
+
+        bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+
+        bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+
+        arrow_proxy<const_reference> operator->() const noexcept {
+            return arrow_proxy<const_reference>{const_reference(belong->keys[idx], belong->vals[idx])};
+        }
+    };
+
+    flat_map() : keys(NULL), vals(NULL), n(0), cap(0), pend(NULL), np(0), pcap(0) {}
+
+    explicit flat_map(const Compare &c)
+            : compare_base<Compare>(c), keys(NULL), vals(NULL), n(0), cap(0), pend(NULL), np(0), pcap(0) {}
+
+    flat_map(const flat_map &other)
+            : compare_base<Compare>(other), keys(NULL), vals(NULL), n(0), cap(0), pend(NULL), np(0), pcap(0) {
+        other.flush();
+        reserve(other.n);
+        for (; n < other.n; ++n) {
+            new(keys + n) Key(other.keys[n]);
+            new(vals + n) T(other.vals[n]);
+        }
+    }
+
+    flat_map(flat_map &&other) noexcept
+            : compare_base<Compare>(other), keys(other.keys), vals(other.vals), n(other.n), cap(other.cap),
+              pend(other.pend), np(other.np), pcap(other.pcap) {
+        other.keys = NULL;
+        other.vals = NULL;
+        other.pend = NULL;
+        other.n = other.cap = other.np = other.pcap = 0;
+    }
+
+    void del() {
+        for (size_t i = 0; i < n; ++i) {
+            keys[i].~Key();
+            vals[i].~T();
+        }
+        for (size_t i = 0; i < np; ++i)pend[i].~value_type();
+        ::operator delete(keys);
+        ::operator delete(vals);
+        ::operator delete(pend);
+        keys = NULL;
+        vals = NULL;
+        pend = NULL;
+        n = cap = np = pcap = 0;
+    }
+
+    flat_map &operator=(const flat_map &other) {
+        if (this == &other)return *this;
+        flat_map tmp(other);
+        return *this = std::move(tmp);
+    }
+
+    flat_map &operator=(flat_map &&other) noexcept {
+        if (this == &other)return *this;
+        del();
+        compare_base<Compare>::operator=(other);
+        keys = other.keys;
+        vals = other.vals;
+        pend = other.pend;
+        n = other.n;
+        cap = other.cap;
+        np = other.np;
+        pcap = other.pcap;
+        other.keys = NULL;
+        other.vals = NULL;
+        other.pend = NULL;
+        other.n = other.cap = other.np = other.pcap = 0;
+        return *this;
+    }
+
+    ~flat_map() {
+        del();
+    }
+
+    // move the elements to arrays of capacity c >= n
+    void realloc(size_t c) const {
+        Key *k = (Key *) ::operator new(c * sizeof(Key));
+        T *v = (T *) ::operator new(c * sizeof(T));
+        for (size_t i = 0; i < n; ++i) {
+            relocate(k + i, keys + i);
+            relocate(v + i, vals + i);
+        }
+        ::operator delete(keys);
+        ::operator delete(vals);
+        keys = k;
+        vals = v;
+        cap = c;
+    }
+
+    void reserve(size_t c) {
+        if (c > cap)realloc(c);
+    }
+
+    /**
+     * index of the first key not less than key.
+     * the loop halves the range without branching on the comparison,
+     * which compiles to conditional moves and keeps the pipeline full.
+     */
+    size_t lower(const Key &key) const {
+        if (!n)return 0;
+        const Key *b = keys;
+        size_t len = n;
+        while (len > 1) {
+            size_t h = len >> 1;
+            b = comp()(b[h], key) ? b + h : b;
+            len -= h;
+        }
+        return b - keys + comp()(*b, key);
+    }
+
+    // index of key, or n
+    size_t search(const Key &key) const {
+        flush();
+        size_t i = lower(key);
+        if (i < n && !comp()(key, keys[i]))return i;
+        return n;
+    }
+
+    // stable merge sort of the indices a[l, r) by the key of pend[a[i]]
+    void sort_pend(size_t *a, size_t *t, size_t l, size_t r) const {
+        if (r - l < 2)return;
+        size_t m = (l + r) >> 1, i = l, j = m, k = l;
+        sort_pend(a, t, l, m);
+        sort_pend(a, t, m, r);
+        while (i < m && j < r)t[k++] = comp()(pend[a[j]].first, pend[a[i]].first) ? a[j++] : a[i++];
+        while (i < m)t[k++] = a[i++];
+        while (j < r)t[k++] = a[j++];
+        for (k = l; k < r; ++k)a[k] = t[k];
+    }
+
+    /**
+     * merge the deferred insertions in. as with insert, keys already present win,
+     * and among deferred equal keys the first one does.
+     */
+    void flush() const {
+        if (!np)return;
+        size_t *a = new size_t[np], *t = new size_t[np], m = 0;
+        for (size_t i = 0; i < np; ++i)a[i] = i;
+        sort_pend(a, t, 0, np);
+        for (size_t i = 0; i < np; ++i) {
+            if (m && !comp()(pend[a[m - 1]].first, pend[a[i]].first))pend[a[i]].~value_type();
+            else a[m++] = a[i];
+        }
+        size_t c = cap < n + m ? (n + m > cap * 2 ? n + m : cap * 2) : cap, i = 0, j = 0, k = 0;
+        Key *nk = (Key *) ::operator new(c * sizeof(Key));
+        T *nv = (T *) ::operator new(c * sizeof(T));
+        while (i < n || j < m) {
+            if (j == m || (i < n && comp()(keys[i], pend[a[j]].first))) {
+                relocate(nk + k, keys + i);
+                relocate(nv + k++, vals + i++);
+            } else if (i < n && !comp()(pend[a[j]].first, keys[i]))pend[a[j++]].~value_type();
+            else {
+                value_type *p = pend + a[j++];
+                new(nk + k) Key(p->first);
+                new(nv + k++) T(std::move(p->second));
+                p->~value_type();
+            }
+        }
+        ::operator delete(keys);
+        ::operator delete(vals);
+        keys = nk;
+        vals = nv;
+        n = k;
+        cap = c;
+        np = 0;
+        delete[] a;
+        delete[] t;
+    }
+
+    /**
+     * insert key with the value constructed from args at index i, shifting the rest right.
+     * both are built before the arrays can move, so args may refer into them.
+     */
+    template<class K, class... Args>
+    iterator insert_at(size_t i, K &&key, Args &&... args) {
+        Key k(std::forward<K>(key));
+        T v(std::forward<Args>(args)...);
+        if (n == cap)realloc(cap ? cap * 2 : 8);
+        new(keys + n) Key(std::move(k));
+        try {
+            new(vals + n) T(std::move(v));
+        } catch (...) {
+            keys[n].~Key();
+            throw;
+        }
+        rotate_in(keys, i, n);
+        rotate_in(vals, i, n);
+        ++n;
+        return iterator(this, i);
+    }
+
+    /**
+     * append value to the deferred buffer, see flush().
+     */
+    template<class V>
+    void defer_insert(V &&value) {
+        if (np == pcap) {
+            size_t c = pcap ? pcap * 2 : 8;
+            value_type *p = (value_type *) ::operator new(c * sizeof(value_type));
+            for (size_t i = 0; i < np; ++i)relocate(p + i, pend + i);
+            ::operator delete(pend);
+            pend = p;
+            pcap = c;
+        }
+        new(pend + np) value_type(std::forward<V>(value));
+        ++np;
+    }
+
+    T &at(const Key &key) {
+        size_t i = search(key);
+        if (i == n)throw index_out_of_bound();
+        return vals[i];
+    }
+
+    const T &at(const Key &key) const {
+        size_t i = search(key);
+        if (i == n)throw index_out_of_bound();
+        return vals[i];
+    }
+
+    T &operator[](const Key &key) {
+        flush();
+        size_t i = lower(key);
+        if (i < n && !comp()(key, keys[i]))return vals[i];
+        return insert_at(i, key)->second;
+    }
+
+    T &operator[](Key &&key) {
+        flush();
+        size_t i = lower(key);
+        if (i < n && !comp()(key, keys[i]))return vals[i];
+        return insert_at(i, std::move(key))->second;
+    }
+
+    const T &operator[](const Key &key) const {
+        return at(key);
+    }
+
+    iterator begin() {
+        flush();
+        return iterator(this, 0);
+    }
+
+    const_iterator cbegin() const {
+        flush();
+        return const_iterator(this, 0);
+    }
+
+    iterator end() {
+        flush();
+        return iterator(this, n);
+    }
+
+    const_iterator cend() const {
+        flush();
+        return const_iterator(this, n);
+    }
+
+    bool empty() const { return !size(); }
+
+    size_t size() const {
+        flush();
+        return n;
+    }
+
+    void clear() {
+        del();
+    }
+
+    pair<iterator, bool> insert(const value_type &value) {
+        flush();
+        size_t i = lower(value.first);
+        if (i < n && !comp()(value.first, keys[i]))return pair<iterator, bool>(iterator(this, i), false);
+        return pair<iterator, bool>(insert_at(i, value.first, value.second), true);
+    }
+
+    pair<iterator, bool> insert(value_type &&value) {
+        flush();
+        size_t i = lower(value.first);
+        if (i < n && !comp()(value.first, keys[i]))return pair<iterator, bool>(iterator(this, i), false);
+        return pair<iterator, bool>(insert_at(i, value.first, std::move(value.second)), true);
+    }
+
+    /**
+     * insert [first, last) through the deferred buffer, merged in one pass.
+     */
+    template<class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (; first != last; ++first)defer_insert(*first);
+        flush();
+    }
+
+    template<class... Args>
+    pair<iterator, bool> emplace(Args &&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    template<class... Args>
+    pair<iterator, bool> try_emplace(const Key &key, Args &&... args) {
+        flush();
+        size_t i = lower(key);
+        if (i < n && !comp()(key, keys[i]))return pair<iterator, bool>(iterator(this, i), false);
+        return pair<iterator, bool>(insert_at(i, key, std::forward<Args>(args)...), true);
+    }
+
+    /**
+     * erase the element at pos.
+     *
+     * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+     */
+    void erase(iterator pos) {
+        if (pos.check_invalid() || pos.belong != this || pos.check_end())throw invalid_iterator();
+        keys[pos.idx].~Key();
+        vals[pos.idx].~T();
+        for (size_t j = pos.idx + 1; j < n; ++j) {
+            relocate(keys + j - 1, keys + j);
+            relocate(vals + j - 1, vals + j);
+        }
+        --n;
+    }
+
+    size_t count(const Key &key) const {
+        return search(key) != n;
+    }
+
+    iterator find(const Key &key) {
+        return iterator(this, search(key));
+    }
+
+    const_iterator find(const Key &key) const {
+        return const_iterator(this, search(key));
+    }
+
+    iterator lower_bound(const Key &key) {
+        flush();
+        return iterator(this, lower(key));
+    }
+
+    const_iterator lower_bound(const Key &key) const {
+        flush();
+        return const_iterator(this, lower(key));
+    }
+
+    iterator upper_bound(const Key &key) {
+        size_t i = lower_bound(key).idx;
+        return iterator(this, i < n && !comp()(key, keys[i]) ? i + 1 : i);
+    }
+
+    const_iterator upper_bound(const Key &key) const {
+        size_t i = lower_bound(key).idx;
+        return const_iterator(this, i < n && !comp()(key, keys[i]) ? i + 1 : i);
+    }
+};
+
+}
+
+#endif
@@ -8,17 +8,32 @@
 #include<iostream>
 #include <functional>
 #include <cstddef>
+#include <utility>
+#include <type_traits>
 #include "utility.hpp"
+#include "compare_base.hpp"
 #include "exceptions.hpp"
+#include "node_pool.hpp"
 
 namespace sjtu {
 
+/**
+ * nodes are drawn from a per-map Pool<node>, sjtu::node_pool by default.
+ * any template providing allocate(), deallocate(p), reserve(n), release(), share(other)
+ * and move construction/assignment can be plugged in instead.
+ * split, join and merge move nodes between maps, which then share() their pools.
+ *
+ * the comparator is kept once per map, so it may carry state;
+ *   key_comp() returns a copy of it.
+ */
 template<
 	class Key,
 	class T,
-	class Compare = std::less<Key>
-> class map {
+	class Compare = std::less<Key>,
+	template<class> class Pool = node_pool
+> class map : public compare_base<Compare> {
 public:
+    using compare_base<Compare>::comp;
     /**
      * the internal type of data.
     * it should have a default constructor, a copy constructor.
@@ -33,39 +48,50 @@ public:
      *     like it = map.begin(); --it;
      *       or it = map.end(); ++end();
      */
+    // tag for building a node from a key and the arguments of its mapped value
+    struct piecewise {
+    };
+
     struct node {
-        map *belong;
-        value_type *val;
+        value_type *val;//points into buf, NULL for the end node
         bool col;//RED:0,Black:1
+        int siz;//nodes in the subtree, the end node included
         node *lc, *rc, *pre;
+        alignas(value_type) unsigned char buf[sizeof(value_type)];
 
-        node(map *_belong) : belong(_belong) {
+        node() {
             val = NULL;
             lc = rc = pre = NULL;
             col = 0;
+            siz = 1;
         }
 
-        node(map *_belong, value_type _val, int _col = 0) : belong(_belong), col(_col) {
-            val = new value_type(_val);
+        // constructs the value in place from args
+        template<class... Args>
+        explicit node(Args &&... args) : col(0), siz(1) {
+            val = new(buf) value_type(std::forward<Args>(args)...);
             lc = rc = pre = NULL;
         }
 
-        node(const node &other) {
-            belong = other.belong;
-            col = other.col;
-            if (other.val != NULL)val = new value_type(*other.val);
-            else val = NULL;
+        /**
+         * constructs the key from key and the mapped value from args, each in place.
+         * the converting constructors of sjtu::pair copy their arguments, so they are bypassed.
+         */
+        template<class K, class... Args>
+        node(piecewise, K &&key, Args &&... args) : col(0), siz(1) {
+            val = (value_type *) (void *) buf;
+            new((void *) &val->first) Key(std::forward<K>(key));
+            try {
+                new((void *) &val->second) T(std::forward<Args>(args)...);
+            } catch (...) {
+                val->first.~Key();
+                throw;
+            }
             lc = rc = pre = NULL;
         }
 
         ~node() {
-            delete val;
-        }
-
-        bool operator<(const node &right) const {
-            if (val == NULL)return 0;
-            if (right.val == NULL)return 1;
-            return Compare()(val->first, right.val->first);
+            if (val != NULL)val->~value_type();
         }
 
         node *getnxt() {
@@ -93,6 +119,59 @@ public:
 
     node *root, *ed;
     int sz;
+    Pool<node> pool;
+
+    static int size_of(node *x) { return x == NULL ? 0 : x->siz; }
+
+    // number of nodes before x in key order
+    static int rank_of(node *x) {
+        int r = size_of(x->lc);
+        for (; x->pre != NULL; x = x->pre)
+            if (x->pre->rc == x)r += size_of(x->pre->lc) + 1;
+        return r;
+    }
+
+    // the k-th node of the tree under x, counting from 0
+    static node *kth(node *x, int k) {
+        while (k != size_of(x->lc)) {
+            if (k < size_of(x->lc))x = x->lc;
+            else {
+                k -= size_of(x->lc) + 1;
+                x = x->rc;
+            }
+        }
+        return x;
+    }
+
+    static node *top(node *x) {
+        while (x->pre != NULL)x = x->pre;
+        return x;
+    }
+
+    // the node n places after x, throw if it falls outside [begin(), end()]
+    static node *advance(node *x, int n) {
+        node *r = top(x);
+        long long k = (long long) rank_of(x) + n;
+        if (k < 0 || k >= r->siz)throw invalid_iterator();
+        return kth(r, (int) k);
+    }
+
+    template<class... Args>
+    node *new_node(Args &&... args) {
+        node *x = pool.allocate();
+        try {
+            new(x) node(std::forward<Args>(args)...);
+        } catch (...) {
+            pool.deallocate(x);
+            throw;
+        }
+        return x;
+    }
+
+    void delete_node(node *x) {
+        x->~node();
+        pool.deallocate(x);
+    }
 
     class const_iterator;
 
@@ -123,6 +202,38 @@ public:
         /**
          * TODO iter++
          */
+        /**
+         * move n elements forward (backward for negative n) in O(log n).
+         * throw invalid_iterator if the result would be before begin() or past end().
+         */
+        iterator operator+(int n) const {
+            if (check_invalid())throw invalid_iterator();
+            return iterator(advance(cur, n));
+        }
+
+        iterator operator-(int n) const {
+            if (check_invalid())throw invalid_iterator();
+            return iterator(advance(cur, -n));
+        }
+
+        iterator &operator+=(int n) {
+            if (check_invalid())throw invalid_iterator();
+            cur = advance(cur, n);
+            return *this;
+        }
+
+        iterator &operator-=(int n) {
+            if (check_invalid())throw invalid_iterator();
+            cur = advance(cur, -n);
+            return *this;
+        }
+
+        // distance in O(log n), throw if the iterators belong to different maps
+        int operator-(const iterator &rhs) const {
+            if (check_invalid() || rhs.check_invalid() || top(cur) != top(rhs.cur))throw invalid_iterator();
+            return rank_of(cur) - rank_of(rhs.cur);
+        }
+
         iterator operator++(int) {
             if (check_invalid())throw invalid_iterator();
             iterator ret(*this);
@@ -209,6 +320,38 @@ public:
             cur = other.cur;
         }
 
+        /**
+         * move n elements forward (backward for negative n) in O(log n).
+         * throw invalid_iterator if the result would be before begin() or past end().
+         */
+        const_iterator operator+(int n) const {
+            if (check_invalid())throw invalid_iterator();
+            return const_iterator(advance(cur, n));
+        }
+
+        const_iterator operator-(int n) const {
+            if (check_invalid())throw invalid_iterator();
+            return const_iterator(advance(cur, -n));
+        }
+
+        const_iterator &operator+=(int n) {
+            if (check_invalid())throw invalid_iterator();
+            cur = advance(cur, n);
+            return *this;
+        }
+
+        const_iterator &operator-=(int n) {
+            if (check_invalid())throw invalid_iterator();
+            cur = advance(cur, -n);
+            return *this;
+        }
+
+        // distance in O(log n), throw if the iterators belong to different maps
+        int operator-(const const_iterator &rhs) const {
+            if (check_invalid() || rhs.check_invalid() || top(cur) != top(rhs.cur))throw invalid_iterator();
+            return rank_of(cur) - rank_of(rhs.cur);
+        }
+
         const_iterator operator++(int) {
             if (check_invalid())throw invalid_iterator();
             const_iterator ret(*this);
@@ -273,45 +416,113 @@ public:
      * TODO two constructors
      */
     map() {
-        ed = root = new node(this);
+        ed = root = new_node();
         sz = 0;
     }
 
+    explicit map(const Compare &c) : compare_base<Compare>(c) {
+        ed = root = new_node();
+        sz = 0;
+    }
+
+    node *clone(node *y) {
+        node *x = y->val == NULL ? new_node() : new_node(*y->val);
+        x->col = y->col;
+        x->siz = y->siz;
+        return x;
+    }
+
+    /**
+     * copy the tree under y in preorder, climbing back through the parent links
+     * instead of recursing. the copies are laid out in one slab reserved up front.
+     */
     node *copy(node *y) {
-        node *x = new node(*y);
-        x->belong = this;
-        if (y->lc != NULL) {
-            x->lc = copy(y->lc);
-            x->lc->pre = x;
+        pool.reserve(y->siz);
+        node *r = clone(y), *x = r;
+        for (;;) {
+            if (y->lc != NULL && x->lc == NULL) {
+                x->lc = clone(y->lc);
+                x->lc->pre = x;
+                x = x->lc, y = y->lc;
+            } else if (y->rc != NULL && x->rc == NULL) {
+                x->rc = clone(y->rc);
+                x->rc->pre = x;
+                x = x->rc, y = y->rc;
+            } else if (x == r)break;
+            else x = x->pre, y = y->pre;
         }
-        if (y->rc != NULL) {
-            x->rc = copy(y->rc);
-            x->rc->pre = x;
-        }
-        return x;
+        return r;
     }
 
-    map(const map &other) {
-        root = copy(other.root);
-        for (ed = root; ed->rc != NULL; ed = ed->rc);
+    map(const map &other) : compare_base<Compare>(other) {
+        if (other.root == NULL)ed = root = new_node();
+        else {
+            root = copy(other.root);
+            for (ed = root; ed->rc != NULL; ed = ed->rc);
+        }
         sz = other.sz;
     }
 
+    /**
+     * a moved-from map has no sentinel, it is recreated on the next insertion.
+     */
+    map(map &&other) noexcept
+            : compare_base<Compare>(other), root(other.root), ed(other.ed), sz(other.sz), pool(std::move(other.pool)) {
+        other.root = other.ed = NULL;
+        other.sz = 0;
+    }
+
     /**
      * TODO assignment operator
      */
+    // destroy the values under x, rotating left children up instead of recursing
     void del(node *x) {
-        if (x->lc != NULL)del(x->lc);
-        if (x->rc != NULL)del(x->rc);
-        delete x;
+        while (x != NULL) {
+            node *y;
+            if (x->lc != NULL) {
+                y = x->lc;
+                x->lc = y->rc;
+                y->rc = x;
+            } else {
+                y = x->rc;
+                x->~node();
+            }
+            x = y;
+        }
+    }
+
+    // destroy every node, the memory goes back to the pool in one go
+    void del_all() {
+        if (root == NULL)return;
+        if (!std::is_trivially_destructible<value_type>::value)del(root);
+        root = ed = NULL;
+        sz = 0;
+        pool.release();
     }
 
     map &operator=(const map &other) {
         if (this == &other)return *this;
-        if (root != NULL)del(root);
-        root = copy(other.root);
-        for (ed = root; ed->rc != NULL; ed = ed->rc);
+        compare_base<Compare>::operator=(other);
+        del_all();
+        if (other.root == NULL)ed = root = new_node();
+        else {
+            root = copy(other.root);
+            for (ed = root; ed->rc != NULL; ed = ed->rc);
+        }
+        sz = other.sz;
+        return *this;
+    }
+
+    map &operator=(map &&other) noexcept {
+        if (this == &other)return *this;
+        compare_base<Compare>::operator=(other);
+        del_all();
+        root = other.root;
+        ed = other.ed;
         sz = other.sz;
+        pool = std::move(other.pool);
+        other.root = other.ed = NULL;
+        other.sz = 0;
         return *this;
     }
 
@@ -319,7 +530,7 @@ public:
      * TODO Destructors
      */
     ~map() {
-        del(root);
+        del_all();
     }
 
     /**
@@ -335,6 +546,8 @@ public:
         y->rc = x;
         y->pre = x->pre;
         x->pre = y;
+        y->siz = x->siz;
+        x->siz = size_of(x->lc) + size_of(x->rc) + 1;
         if (root == x)root = y;
         else if (y->pre->lc == x)y->pre->lc = y;
         else y->pre->rc = y;
@@ -347,6 +560,8 @@ public:
         y->lc = x;
         y->pre = x->pre;
         x->pre = y;
+        y->siz = x->siz;
+        x->siz = size_of(x->lc) + size_of(x->rc) + 1;
         if (root == x)root = y;
         else if (y->pre->lc == x)y->pre->lc = y;
         else y->pre->rc = y;
@@ -447,24 +662,34 @@ public:
         }
     }
 
+    /**
+     * with a transparent Compare (one defining is_transparent, like std::less<>),
+     *   lookups also accept any K comparable with Key, without constructing a Key.
+     */
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    T &at(const K &key) {
+        node *x = search(key);
+        if (x == NULL)throw index_out_of_bound();
+        return x->val->second;
+    }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    const T &at(const K &key) const {
+        node *x = search(key);
+        if (x == NULL)throw index_out_of_bound();
+        return x->val->second;
+    }
+
     T &at(const Key &key) {
-        node *x = root;
-        while (x != NULL) {
-            if (x->val != NULL && !Compare()(key, x->val->first) && !Compare()(x->val->first, key))
-                return x->val->second;
-            x = x->val == NULL || Compare()(key, x->val->first) ? x->lc : x->rc;
-        }
-        throw index_out_of_bound();
+        node *x = search(key);
+        if (x == NULL)throw index_out_of_bound();
+        return x->val->second;
     }
 
     const T &at(const Key &key) const {
-        node *x = root;
-        while (x != NULL) {
-            if (x->val != NULL && !Compare()(key, x->val->first) && !Compare()(x->val->first, key))
-                return x->val->second;
-            x = x->val == NULL || Compare()(key, x->val->first) ? x->lc : x->rc;
-        }
-        throw index_out_of_bound();
+        node *x = search(key);
+        if (x == NULL)throw index_out_of_bound();
+        return x->val->second;
     }
 
     /**
@@ -474,34 +699,39 @@ public:
      *   performing an insertion if such key does not already exist.
      */
     T &operator[](const Key &key) {
-        node *x = root;
-        while (x->val == NULL || Compare()(key, x->val->first) || Compare()(x->val->first, key)) {
-            //std::cout<<1;
-            node *&v = x->val == NULL || Compare()(key, x->val->first) ? x->lc : x->rc;
-            if (v == NULL) {
-                ++sz;//std::cout<<std::endl;
-                v = new node(this, value_type(key, T()));
-                v->pre = x;
-                node *y = v;
-                if (!x->col)insert_rebalance(v);
-                return y->val->second;
-            }
-            x = v;
-        }
-        return x->val->second;
+        node *fa, *x = locate(key, fa);
+        if (x != NULL)return x->val->second;
+        return attach(fa, new_node(piecewise(), key))->val->second;
+    }
+
+    T &operator[](Key &&key) {
+        node *fa, *x = locate(key, fa);
+        if (x != NULL)return x->val->second;
+        return attach(fa, new_node(piecewise(), std::move(key)))->val->second;
+    }
+
+    // the Key is constructed from key only when it has to be inserted
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    T &operator[](const K &key) {
+        node *fa, *x = locate(key, fa);
+        if (x != NULL)return x->val->second;
+        return attach(fa, new_node(piecewise(), key))->val->second;
     }
 
     /**
      * behave like at() throw index_out_of_bound if such key does not exist.
      */
     const T &operator[](const Key &key) const {
-        node *x = root;
-        while (x != NULL) {
-            if (x->val != NULL && !Compare()(key, x->val->first) && !Compare()(x->val->first, key))
-                return x->val->second;
-            x = x->val == NULL || Compare()(key, x->val->first) ? x->lc : x->rc;
-        }
-        throw index_out_of_bound();
+        node *x = search(key);
+        if (x == NULL)throw index_out_of_bound();
+        return x->val->second;
+    }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    const T &operator[](const K &key) const {
+        node *x = search(key);
+        if (x == NULL)throw index_out_of_bound();
+        return x->val->second;
     }
 
     /**
@@ -509,12 +739,14 @@ public:
      */
     iterator begin() {
         node *x = root;
+        if (x == NULL)return iterator(ed);
         while (x->lc != NULL)x = x->lc;
         return iterator(x);
     }
 
     const_iterator cbegin() const {
         node *x = root;
+        if (x == NULL)return const_iterator(ed);
         while (x->lc != NULL)x = x->lc;
         return const_iterator(x);
     }
@@ -546,9 +778,8 @@ public:
      * clears the contents
      */
     void clear() {
-        del(root);
-        ed = root = new node(this);
-        sz = 0;
+        del_all();
+        ed = root = new_node();
     }
 
     /**
@@ -557,21 +788,301 @@ public:
      *   the iterator to the new element (or the element that prevented the insertion),
      *   the second one is true if insert successfully, or false.
      */
+    /**
+     * returns the node holding key, or NULL with fa set to the node whose
+     * empty child is where key belongs.
+     */
+    template<class K>
+    node *locate(const K &key, node *&fa) const {
+        node *x = root, *y = NULL;//y: the last node not greater than key
+        fa = NULL;
+        while (x != NULL) {
+            fa = x;
+            if (x->val == NULL || comp()(key, x->val->first))x = x->lc;
+            else y = x, x = x->rc;
+        }
+        if (y != NULL && !comp()(y->val->first, key))return y;
+        return NULL;
+    }
+
+    template<class K>
+    node *search(const K &key) const {
+        node *fa;
+        return locate(key, fa);
+    }
+
+    // link the new node v under fa as returned by locate
+    node *attach(node *fa, node *v) {
+        if (fa == NULL)fa = ed = root = new_node();
+        (fa->val == NULL || comp()(v->val->first, fa->val->first) ? fa->lc : fa->rc) = v;
+        v->pre = fa;
+        for (node *y = fa; y != NULL; y = y->pre)++y->siz;
+        ++sz;
+        if (!fa->col)insert_rebalance(v);
+        return v;
+    }
+
     pair<iterator, bool> insert(const value_type &value) {
-        node *x = root;
-        while (x->val == NULL || Compare()(value.first, x->val->first) || Compare()(x->val->first, value.first)) {
-            node *&v = x->val == NULL || Compare()(value.first, x->val->first) ? x->lc : x->rc;
-            if (v == NULL) {
-                ++sz;
-                v = new node(this, value);
-                v->pre = x;
-                node *y = v;
-                if (!x->col)insert_rebalance(v);
-                return pair<iterator, bool>(y, true);
+        node *fa, *x = locate(value.first, fa);
+        if (x != NULL)return pair<iterator, bool>(iterator(x), false);
+        return pair<iterator, bool>(iterator(attach(fa, new_node(value))), true);
+    }
+
+    pair<iterator, bool> insert(value_type &&value) {
+        node *fa, *x = locate(value.first, fa);
+        if (x != NULL)return pair<iterator, bool>(iterator(x), false);
+        return pair<iterator, bool>(iterator(attach(fa, new_node(std::move(value)))), true);
+    }
+
+    /**
+     * constructs value_type from args, and keeps it only if its key is not present.
+     */
+    template<class... Args>
+    pair<iterator, bool> emplace(Args &&... args) {
+        return emplace_node(new_node(std::forward<Args>(args)...));
+    }
+
+    // a key and a mapped value are forwarded to their members, not through sjtu::pair
+    template<class K, class M>
+    pair<iterator, bool> emplace(K &&key, M &&t) {
+        return emplace_node(new_node(piecewise(), std::forward<K>(key), std::forward<M>(t)));
+    }
+
+    pair<iterator, bool> emplace_node(node *v) {
+        node *fa, *x = locate(v->val->first, fa);
+        if (x != NULL) {
+            delete_node(v);
+            return pair<iterator, bool>(iterator(x), false);
+        }
+        return pair<iterator, bool>(iterator(attach(fa, v)), true);
+    }
+
+    /**
+     * constructs the mapped value from args only if key is not present.
+     */
+    template<class... Args>
+    pair<iterator, bool> try_emplace(const Key &key, Args &&... args) {
+        node *fa, *x = locate(key, fa);
+        if (x != NULL)return pair<iterator, bool>(iterator(x), false);
+        return pair<iterator, bool>(iterator(attach(fa, new_node(piecewise(), key, std::forward<Args>(args)...))), true);
+    }
+
+    template<class... Args>
+    pair<iterator, bool> try_emplace(Key &&key, Args &&... args) {
+        node *fa, *x = locate(key, fa);
+        if (x != NULL)return pair<iterator, bool>(iterator(x), false);
+        return pair<iterator, bool>(iterator(attach(fa, new_node(piecewise(), std::move(key), std::forward<Args>(args)...))), true);
+    }
+
+    // a balanced tree over a[l, r), the nodes on depth h - 1 (the deepest) red, the rest black
+    static node *build(node **a, int l, int r, int d, int h) {
+        if (l == r)return NULL;
+        int m = (l + r) >> 1;
+        node *x = a[m];
+        x->lc = build(a, l, m, d + 1, h);
+        x->rc = build(a, m + 1, r, d + 1, h);
+        if (x->lc != NULL)x->lc->pre = x;
+        if (x->rc != NULL)x->rc->pre = x;
+        x->siz = r - l;
+        x->col = !(d && d == h - 1);
+        return x;
+    }
+
+    /**
+     * rebuild the tree from its own nodes merged with a[0, n), which are unlinked,
+     * in ascending key order, and have no duplicates among themselves.
+     * nodes of a whose key is already present are dropped. O(size() + n).
+     */
+    void merge_build(node **a, int n) {
+        int m = sz + 1, k = 0, i = 0;
+        node **b = new node *[m + n], *x = root;
+        while (x->lc != NULL)x = x->lc;
+        for (int j = 0; j < n; ++j) {
+            while (x != ed && comp()(x->val->first, a[j]->val->first)) {
+                b[k++] = x;
+                x = x->getnxt();
             }
-            x = v;
+            if (x != ed && !comp()(a[j]->val->first, x->val->first))delete_node(a[j]);
+            else b[k++] = a[j], ++i;
+        }
+        for (; x != ed; x = x->getnxt())b[k++] = x;
+        b[k++] = ed;
+        int h = 0;
+        while ((1 << h) <= k)++h;
+        root = build(b, 0, k, 0, h);
+        root->pre = NULL;
+        sz += i;
+        delete[] b;
+    }
+
+    static void push_node(node **&a, int &n, int &cap, node *v) {
+        if (n == cap) {
+            node **t = new node *[cap = cap ? cap * 2 : 16];
+            for (int i = 0; i < n; ++i)t[i] = a[i];
+            delete[] a;
+            a = t;
+        }
+        a[n++] = v;
+    }
+
+    /**
+     * link the unlinked nodes a[0, n), ascending in key without duplicates.
+     * a few nodes go in one by one, more than size() / 16 rebuild the tree around them.
+     */
+    void insert_nodes(node **a, int n) {
+        if ((long long) n * 16 >= sz) {
+            if (n)merge_build(a, n);
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            node *fa, *x = locate(a[i]->val->first, fa);
+            if (x != NULL)delete_node(a[i]);
+            else attach(fa, a[i]);
         }
-        return pair<iterator, bool>(iterator(x), false);
+    }
+
+    // stable merge sort of a[l, r) by key, t is scratch space of the same size
+    void sort_nodes(node **a, node **t, int l, int r) {
+        if (r - l < 2)return;
+        int m = (l + r) >> 1, i = l, j = m, k = l;
+        sort_nodes(a, t, l, m);
+        sort_nodes(a, t, m, r);
+        while (i < m && j < r)t[k++] = comp()(a[j]->val->first, a[i]->val->first) ? a[j++] : a[i++];
+        while (i < m)t[k++] = a[i++];
+        while (j < r)t[k++] = a[j++];
+        for (k = l; k < r; ++k)a[k] = t[k];
+    }
+
+    /**
+     * insert the elements of [first, last) in any order.
+     * they are sorted first and then merged into the tree in one pass, see insert_sorted.
+     * as with insert, the first of several equal keys wins and present keys are kept.
+     */
+    template<class InputIt>
+    void insert(InputIt first, InputIt last) {
+        if (root == NULL)ed = root = new_node();
+        node **a = NULL;
+        int n = 0, cap = 0;
+        try {
+            for (; first != last; ++first)push_node(a, n, cap, new_node(*first));
+        } catch (...) {
+            for (int i = 0; i < n; ++i)delete_node(a[i]);
+            delete[] a;
+            throw;
+        }
+        node **t = new node *[n + 1];
+        sort_nodes(a, t, 0, n);
+        int k = 0;
+        for (int i = 0; i < n; ++i) {
+            if (k && !comp()(a[k - 1]->val->first, a[i]->val->first))delete_node(a[i]);
+            else a[k++] = a[i];
+        }
+        delete[] t;
+        insert_nodes(a, k);
+        delete[] a;
+    }
+
+    /**
+     * like locate, but first tries the place next to h, which costs two comparisons when
+     *   key belongs right before h or right after it.
+     */
+    node *locate(node *h, const Key &key, node *&fa) const {
+        if (h->val == NULL || comp()(key, h->val->first)) {
+            node *p = h;
+            if (h->lc != NULL)for (p = h->lc; p->rc != NULL; p = p->rc);
+            else {
+                while (p->pre != NULL && p->pre->rc != p)p = p->pre;
+                p = p->pre;
+            }
+            if (p == NULL || comp()(p->val->first, key)) {
+                fa = h->lc == NULL ? h : p;
+                return NULL;
+            }
+            if (!comp()(key, p->val->first))return p;
+        } else if (comp()(h->val->first, key)) {
+            node *q = h;
+            if (h->rc != NULL)for (q = h->rc; q->lc != NULL; q = q->lc);
+            else {
+                while (q->pre->lc != q)q = q->pre;
+                q = q->pre;
+            }
+            if (q->val == NULL || comp()(key, q->val->first)) {
+                fa = h->rc == NULL ? h : q;
+                return NULL;
+            }
+            if (!comp()(q->val->first, key))return q;
+        } else return h;
+        return locate(key, fa);
+    }
+
+    /**
+     * insert value using hint, the element the new one should come right before (or right after).
+     * with a correct hint, like end() for ascending keys, placement takes two comparisons
+     *   instead of a descent from the root. a wrong hint only costs the normal insertion.
+     * return the new element, or the one that prevented the insertion.
+     *
+     * throw invalid_iterator if hint is not an iterator of this map.
+     */
+    iterator insert(iterator hint, const value_type &value) {
+        if (hint.check_invalid() || top(hint.cur) != root)throw invalid_iterator();
+        node *fa, *x = locate(hint.cur, value.first, fa);
+        if (x != NULL)return iterator(x);
+        return iterator(attach(fa, new_node(value)));
+    }
+
+    iterator insert(iterator hint, value_type &&value) {
+        if (hint.check_invalid() || top(hint.cur) != root)throw invalid_iterator();
+        node *fa, *x = locate(hint.cur, value.first, fa);
+        if (x != NULL)return iterator(x);
+        return iterator(attach(fa, new_node(std::move(value))));
+    }
+
+    /**
+     * insert the elements of [first, last), ascending in key, in O(size() + n)
+     *   by rebuilding the tree bottom-up instead of rebalancing after each insertion.
+     * elements whose key is already present (or repeats in the input) are skipped, as by insert.
+     * if the input turns out not to be sorted, the rest of it is inserted one by one.
+     */
+    template<class InputIt>
+    void insert_sorted(InputIt first, InputIt last) {
+        if (root == NULL)ed = root = new_node();
+        node **a = NULL, *v = NULL;
+        int n = 0, cap = 0;
+        try {
+            for (; first != last; ++first) {
+                v = new_node(*first);
+                if (n && !comp()(a[n - 1]->val->first, v->val->first)) {
+                    if (comp()(v->val->first, a[n - 1]->val->first))break;
+                    delete_node(v);
+                    v = NULL;
+                    continue;
+                }
+                push_node(a, n, cap, v);
+                v = NULL;
+            }
+        } catch (...) {
+            if (v != NULL)delete_node(v);
+            for (int i = 0; i < n; ++i)delete_node(a[i]);
+            delete[] a;
+            throw;
+        }
+        insert_nodes(a, n);
+        delete[] a;
+        if (v == NULL)return;
+        node *fa, *x = locate(v->val->first, fa);
+        if (x != NULL)delete_node(v);
+        else attach(fa, v);
+        for (++first; first != last; ++first)emplace(*first);
+    }
+
+    /**
+     * builds the map from [first, last), in O(n) if the keys are ascending.
+     */
+    template<class InputIt>
+    map(InputIt first, InputIt last, const Compare &c = Compare()) : compare_base<Compare>(c) {
+        ed = root = new_node();
+        sz = 0;
+        insert_sorted(first, last);
     }
 
     /**
@@ -595,6 +1106,7 @@ public:
             y->lc = x;
             std::swap(x->rc, y->rc);
             std::swap(x->col, y->col);
+            std::swap(x->siz, y->siz);
         } else if (x->rc == y) {
             if (x->lc != NULL)x->lc->pre = y;
             if (y->lc != NULL)y->lc->pre = x;
@@ -609,6 +1121,7 @@ public:
             y->rc = x;
             std::swap(x->lc, y->lc);
             std::swap(x->col, y->col);
+            std::swap(x->siz, y->siz);
         } else {
             if (x->lc != NULL)x->lc->pre = y;
             if (x->rc != NULL)x->rc->pre = y;
@@ -626,21 +1139,23 @@ public:
             std::swap(x->rc, y->rc);
             std::swap(x->pre, y->pre);
             std::swap(x->col, y->col);
+            std::swap(x->siz, y->siz);
         }
     }
 
-    void erase(iterator pos) {
-        if (pos.cur->belong != this)throw invalid_iterator();
-        if (pos.check_invalid() || pos.check_end())throw invalid_iterator();
-        node *x = pos.cur;
+    // take v out of the tree without destroying it
+    void unlink(node *v) {
+        node *x = v;
         if (x->lc != NULL && x->rc != NULL) {
             for (x = x->rc; x->lc != NULL; x = x->lc);
-            SWAP(x, pos.cur);
-            x = pos.cur;
+            SWAP(x, v);
+            x = v;
             /*     delete pos.cur->val;
                  if(x->val!=NULL)pos.cur->val=new value_type(*x->val);
                  else pos.cur->val=NULL,ed=pos.cur;*/
         }
+        for (node *y = x->pre; y != NULL; y = y->pre)--y->siz;
+        x->siz = 0;
         if (x->lc != NULL || x->rc != NULL) {
             node *y = x->lc == NULL ? x->rc : x->lc;
             y->col = 1;
@@ -648,16 +1163,203 @@ public:
             if (x == root)root = y;
             else if (x->pre->lc == x)x->pre->lc = y;
             else x->pre->rc = y;
-            delete x;
-        } else {
+        } else if (x == root)root = NULL;
+        else {
             if (x->col)erase_rebalance(x);
             if (x->pre->lc == x)x->pre->lc = NULL;
             else x->pre->rc = NULL;
-            delete x;
         }
+        x->lc = x->rc = x->pre = NULL;
+        x->col = 0;
+        x->siz = 1;
+    }
+
+    void erase(iterator pos) {
+        if (pos.check_invalid() || pos.check_end())throw invalid_iterator();
+        node *r = pos.cur;
+        while (r->pre != NULL)r = r->pre;
+        if (r != root)throw invalid_iterator();
+        unlink(pos.cur);
+        delete_node(pos.cur);
         --sz;
     }
 
+    // black nodes on a path from x down to NULL, x included
+    static int black_height(node *x) {
+        int h = 0;
+        for (; x != NULL; x = x->lc)h += x->col;
+        return h;
+    }
+
+    /**
+     * link the detached trees l and r, of black heights hl and hr, with the single node k between them.
+     * every node of l comes before k and every node of r after it.
+     * returns the black root and sets h to its black height. O(|hl - hr| + 1), root is used as scratch.
+     */
+    node *join_tree(node *l, int hl, node *k, node *r, int hr, int &h) {
+        if (l != NULL && !l->col)l->col = 1, ++hl;
+        if (r != NULL && !r->col)r->col = 1, ++hr;
+        if (hl == hr) {
+            k->lc = l;
+            k->rc = r;
+            k->pre = NULL;
+            if (l != NULL)l->pre = k;
+            if (r != NULL)r->pre = k;
+            k->siz = size_of(l) + size_of(r) + 1;
+            k->col = 1;
+            h = hl + 1;
+            return k;
+        }
+        // hang k in place of the first black node of the taller tree's inner spine at the shorter one's height
+        node *x, *p = NULL;
+        int d;
+        if (hl > hr) {
+            for (x = l, d = hl; x != NULL && (!x->col || d != hr); d -= x->col, p = x, x = x->rc);
+            p->rc = k;
+            k->lc = x;
+            k->rc = r;
+            if (r != NULL)r->pre = k;
+            for (node *y = p; y != NULL; y = y->pre)y->siz += size_of(r) + 1;
+            root = l;
+        } else {
+            for (x = r, d = hr; x != NULL && (!x->col || d != hl); d -= x->col, p = x, x = x->lc);
+            p->lc = k;
+            k->rc = x;
+            k->lc = l;
+            if (l != NULL)l->pre = k;
+            for (node *y = p; y != NULL; y = y->pre)y->siz += size_of(l) + 1;
+            root = r;
+        }
+        if (x != NULL)x->pre = k;
+        k->pre = p;
+        k->siz = size_of(k->lc) + size_of(k->rc) + 1;
+        k->col = 0;
+        insert_rebalance(k);
+        h = hl > hr ? hl : hr;
+        if (!root->col)root->col = 1, ++h;
+        return root;
+    }
+
+    /**
+     * cut the detached tree x, of black height hx, into l (the nodes whose key is less than key)
+     *   and r (the rest, the end node included), with black heights hl and hr.
+     * the joins on the way back up cost O(log n) in total.
+     */
+    template<class K>
+    void split_tree(node *x, int hx, const K &key, node *&l, int &hl, node *&r, int &hr) {
+        if (x == NULL) {
+            l = r = NULL;
+            hl = hr = 0;
+            return;
+        }
+        node *a = x->lc, *b = x->rc;
+        int h = hx - x->col;
+        if (a != NULL)a->pre = NULL;
+        if (b != NULL)b->pre = NULL;
+        if (x->val == NULL || !comp()(x->val->first, key)) {
+            split_tree(a, h, key, l, hl, r, hr);
+            r = join_tree(r, hr, x, b, h, hr);
+        } else {
+            split_tree(b, h, key, l, hl, r, hr);
+            l = join_tree(a, h, x, l, hl, hl);
+        }
+    }
+
+    /**
+     * the detached tree l followed by the detached tree r becomes this map's tree.
+     * m, a node that belongs to neither, is the pivot of the join and comes out unlinked.
+     */
+    void concat(node *l, node *m, node *r) {
+        int h;
+        root = join_tree(l, black_height(l), m, r, black_height(r), h);
+        unlink(m);
+    }
+
+    /**
+     * move the elements whose key is not less than key into a new map and return it;
+     *   this map keeps the ones before key.
+     * O(log n): nodes change hands without being copied, and the two maps share the pool's memory.
+     */
+    map split(const Key &key) {
+        if (root == NULL)ed = root = new_node();
+        map ret(comp());
+        ret.del_all();
+        ret.pool.share(pool);
+        node *e = new_node(), *l, *r;
+        int hl, hr;
+        split_tree(root, black_height(root), key, l, hl, r, hr);
+        ret.root = r;
+        ret.ed = ed;
+        ret.sz = r->siz - 1;
+        root = join_tree(l, hl, e, NULL, 0, hl);
+        ed = e;
+        sz = root->siz - 1;
+        return ret;
+    }
+
+    /**
+     * move every element of other whose key is not in this map here, the rest stay in other.
+     * nodes change hands without being copied, and the two maps share their pools' memory.
+     * O(log n) when the keys of the two maps do not interleave, otherwise O(m log n)
+     *   for the m elements of other, or O(n + m) when m > n / 16: both key sequences
+     *   are walked together and the tree is rebuilt around the new nodes.
+     */
+    void merge(map &other) {
+        if (this == &other || !other.sz)return;
+        if (root == NULL)ed = root = new_node();
+        pool.share(other.pool);
+        node *x = other.root, *y = root;
+        while (x->lc != NULL)x = x->lc;
+        while (y->lc != NULL)y = y->lc;
+        if (!sz || comp()(ed->getpre()->val->first, x->val->first)) {
+            node *e = other.new_node(), *m = ed;
+            unlink(m);
+            concat(root, m, other.root);
+            delete_node(m);
+            ed = other.ed;
+            sz += other.sz;
+            other.root = other.ed = e;
+            other.sz = 0;
+        } else if (comp()(other.ed->getpre()->val->first, y->val->first)) {
+            node *e = other.new_node(), *m = other.ed;
+            other.unlink(m);
+            concat(other.root, m, root);
+            delete_node(m);
+            sz += other.sz;
+            other.root = other.ed = e;
+            other.sz = 0;
+        } else {
+            node **a = NULL;
+            int n = 0, cap = 0;
+            try {
+                if ((long long) other.sz * 16 >= sz) {
+                    for (; x != other.ed; x = x->getnxt()) {
+                        while (y != ed && comp()(y->val->first, x->val->first))y = y->getnxt();
+                        if (y == ed || comp()(x->val->first, y->val->first))push_node(a, n, cap, x);
+                    }
+                } else for (; x != other.ed; x = x->getnxt())if (search(x->val->first) == NULL)push_node(a, n, cap, x);
+            } catch (...) {
+                delete[] a;
+                throw;
+            }
+            for (int i = 0; i < n; ++i)other.unlink(a[i]);
+            other.sz -= n;
+            insert_nodes(a, n);
+            delete[] a;
+        }
+    }
+
+    /**
+     * the map of the elements of left and right, taken out of both.
+     * O(log n) when every key of left is less than every key of right (or the other way round),
+     *   otherwise it is a merge, and the elements of right whose key is in left stay in right.
+     */
+    static map join(map &left, map &right) {
+        map ret(std::move(left));
+        ret.merge(right);
+        return ret;
+    }
+
     /**
      * Returns the number of elements with key
      *   that compares equivalent to the specified argument,
@@ -666,12 +1368,119 @@ public:
      * The default method of check the equivalence is !(a < b || b > a)
      */
     size_t count(const Key &key) const {
-        node *x = root;
+        return search(key) != NULL;
+    }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    size_t count(const K &key) const {
+        return search(key) != NULL;
+    }
+
+    /**
+     * number of elements with key less than key, in O(log n).
+     */
+    size_t rank(const Key &key) const {
+        if (root == NULL)return 0;
+        return rank_of(lower(key));
+    }
+
+    /**
+     * iterator to the k-th smallest element counting from 0, end() for k == size(), in O(log n).
+     * throw index_out_of_bound if k > size().
+     */
+    iterator select(size_t k) {
+        if (k > (size_t) sz)throw index_out_of_bound();
+        if (root == NULL)return end();
+        return iterator(kth(root, (int) k));
+    }
+
+    const_iterator select(size_t k) const {
+        if (k > (size_t) sz)throw index_out_of_bound();
+        if (root == NULL)return cend();
+        return const_iterator(kth(root, (int) k));
+    }
+
+    // first node whose key is not less than key, ed if there is none
+    template<class K>
+    node *lower(const K &key) const {
+        node *x = root, *r = ed;
+        while (x != NULL) {
+            if (x->val == NULL || !comp()(x->val->first, key))r = x, x = x->lc;
+            else x = x->rc;
+        }
+        return r;
+    }
+
+    // first node whose key is greater than key, ed if there is none
+    template<class K>
+    node *upper(const K &key) const {
+        node *x = root, *r = ed;
         while (x != NULL) {
-            if (x->val != NULL && !Compare()(key, x->val->first) && !Compare()(x->val->first, key))return 1;
-            x = x->val == NULL || Compare()(key, x->val->first) ? x->lc : x->rc;
+            if (x->val == NULL || comp()(key, x->val->first))r = x, x = x->lc;
+            else x = x->rc;
         }
-        return 0;
+        return r;
+    }
+
+    /**
+     * iterator to the first element whose key is not less than key,
+     *   or end() if there is none.
+     */
+    iterator lower_bound(const Key &key) { return iterator(lower(key)); }
+
+    const_iterator lower_bound(const Key &key) const { return const_iterator(lower(key)); }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    iterator lower_bound(const K &key) { return iterator(lower(key)); }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    const_iterator lower_bound(const K &key) const { return const_iterator(lower(key)); }
+
+    /**
+     * iterator to the first element whose key is greater than key,
+     *   or end() if there is none.
+     */
+    iterator upper_bound(const Key &key) { return iterator(upper(key)); }
+
+    const_iterator upper_bound(const Key &key) const { return const_iterator(upper(key)); }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    iterator upper_bound(const K &key) { return iterator(upper(key)); }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    const_iterator upper_bound(const K &key) const { return const_iterator(upper(key)); }
+
+    pair<iterator, iterator> equal_range(const Key &key) {
+        return pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+    }
+
+    pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+        return pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+    }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    pair<iterator, iterator> equal_range(const K &key) {
+        return pair<iterator, iterator>(iterator(lower(key)), iterator(upper(key)));
+    }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    pair<const_iterator, const_iterator> equal_range(const K &key) const {
+        return pair<const_iterator, const_iterator>(const_iterator(lower(key)), const_iterator(upper(key)));
+    }
+
+    /**
+     * calls f(value) for every element with key in [lo, hi), in key order.
+     * O(log n + k) for k visited elements. f must not insert or erase.
+     */
+    template<class F>
+    void for_range(const Key &lo, const Key &hi, F f) {
+        for (node *x = lower(lo); x != ed && comp()(x->val->first, hi); x = x->getnxt())f(*x->val);
+    }
+
+    template<class F>
+    void for_range(const Key &lo, const Key &hi, F f) const {
+        for (node *x = lower(lo); x != ed && comp()(x->val->first, hi); x = x->getnxt())
+            f(static_cast<const value_type &>(*x->val));
     }
 
     /**
@@ -681,22 +1490,25 @@ public:
      *   If no such element is found, past-the-end (see end()) iterator is returned.
      */
     iterator find(const Key &key) {
-        node *x = root;
-        while (x != NULL) {
-            if (x->val != NULL && !Compare()(key, x->val->first) && !Compare()(x->val->first, key))return iterator(x);
-            x = x->val == NULL || Compare()(key, x->val->first) ? x->lc : x->rc;
-        }
-        return iterator(ed);
+        node *x = search(key);
+        return iterator(x == NULL ? ed : x);
     }
 
     const_iterator find(const Key &key) const {
-        node *x = root;
-        while (x != NULL) {
-            if (x->val != NULL && !Compare()(key, x->val->first) && !Compare()(x->val->first, key))
-                return const_iterator(x);
-            x = x->val == NULL || Compare()(key, x->val->first) ? x->lc : x->rc;
-        }
-        return const_iterator(ed);
+        node *x = search(key);
+        return const_iterator(x == NULL ? ed : x);
+    }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    iterator find(const K &key) {
+        node *x = search(key);
+        return iterator(x == NULL ? ed : x);
+    }
+
+    template<class K, class C = Compare, class = typename C::is_transparent>
+    const_iterator find(const K &key) const {
+        node *x = search(key);
+        return const_iterator(x == NULL ? ed : x);
     }
 };
 
@@ -0,0 +1,165 @@
+#ifndef SJTU_NODE_POOL_HPP
+#define SJTU_NODE_POOL_HPP
+
+#include <cstddef>
+#include <new>
+#include <atomic>
+
+namespace sjtu {
+
+/**
+ * a slab allocator for objects of one type.
+ * memory is taken from the system in slabs of growing size and freed slots
+ * go to a free list, so allocate() and deallocate() are O(1) and only
+ * release() (or the destructor) gives memory back, one slab at a time.
+ * the pool hands out raw storage: constructing and destroying objects is up to the caller.
+ *
+ * objects may move between pools that share() each other's slabs: a slab is
+ * reference counted by the pools holding it and freed by the last one to let go,
+ * possibly on another thread. each pool still allocates only from its own slabs.
+ */
+template<class T>
+class node_pool {
+public:
+    union slot {
+        slot *nxt;
+        alignas(T) unsigned char buf[sizeof(T)];
+    };
+
+    // the slabs held, ascending in address; slot 0 of each is its reference count
+    slot **slabs;
+    size_t nslab, cap;
+    slot *fre, *cur, *lim;
+    size_t next;
+
+    static std::atomic<int> *ref(slot *s) {
+        return (std::atomic<int> *) (void *) s;
+    }
+
+    // make room for n more slabs in the list
+    void fit(size_t n) {
+        if (nslab + n <= cap)return;
+        size_t c = cap ? cap * 2 : 8;
+        while (c < nslab + n)c *= 2;
+        slot **t = new slot *[c];
+        for (size_t i = 0; i < nslab; ++i)t[i] = slabs[i];
+        delete[] slabs;
+        slabs = t;
+        cap = c;
+    }
+
+    void grow(size_t n) {
+        fit(1);
+        slot *s = new slot[n + 1];
+        new(s) std::atomic<int>(1);
+        size_t i = nslab++;
+        for (; i && slabs[i - 1] > s; --i)slabs[i] = slabs[i - 1];
+        slabs[i] = s;
+        cur = s + 1;
+        lim = s + n + 1;
+        if (next < (1 << 16))next *= 2;
+    }
+
+    node_pool() : slabs(NULL), nslab(0), cap(0), fre(NULL), cur(NULL), lim(NULL), next(16) {}
+
+    // copies never share memory
+    node_pool(const node_pool &) : node_pool() {}
+
+    node_pool(node_pool &&other) noexcept
+            : slabs(other.slabs), nslab(other.nslab), cap(other.cap),
+              fre(other.fre), cur(other.cur), lim(other.lim), next(other.next) {
+        other.slabs = NULL;
+        other.fre = other.cur = other.lim = NULL;
+        other.nslab = other.cap = 0;
+        other.next = 16;
+    }
+
+    node_pool &operator=(const node_pool &) {
+        return *this;
+    }
+
+    node_pool &operator=(node_pool &&other) noexcept {
+        if (this == &other)return *this;
+        release();
+        slabs = other.slabs;
+        nslab = other.nslab;
+        cap = other.cap;
+        fre = other.fre;
+        cur = other.cur;
+        lim = other.lim;
+        next = other.next;
+        other.slabs = NULL;
+        other.fre = other.cur = other.lim = NULL;
+        other.nslab = other.cap = 0;
+        other.next = 16;
+        return *this;
+    }
+
+    ~node_pool() {
+        release();
+    }
+
+    T *allocate() {
+        if (fre != NULL) {
+            slot *p = fre;
+            fre = p->nxt;
+            return (T *) p;
+        }
+        if (cur == lim)grow(next);
+        return (T *) cur++;
+    }
+
+    /**
+     * the next n allocations will not need the system,
+     * and if nothing has been freed they are contiguous.
+     */
+    void reserve(size_t n) {
+        if ((size_t) (lim - cur) < n)grow(n);
+    }
+
+    void deallocate(T *p) {
+        slot *s = (slot *) p;
+        s->nxt = fre;
+        fre = s;
+    }
+
+    /**
+     * hold every slab of other too, so that objects allocated by other
+     *   may be deallocated here or outlive other. O(number of slabs).
+     */
+    void share(const node_pool &other) {
+        if (this == &other)return;
+        slot **t = new slot *[nslab + other.nslab], **a = slabs, **b = other.slabs;
+        size_t i = 0, j = 0, k = 0;
+        while (i < nslab || j < other.nslab) {
+            if (j == other.nslab || (i < nslab && a[i] < b[j]))t[k++] = a[i++];
+            else {
+                if (i == nslab || b[j] < a[i])ref(b[j])->fetch_add(1, std::memory_order_relaxed), t[k++] = b[j];
+                else t[k++] = a[i++];
+                ++j;
+            }
+        }
+        delete[] slabs;
+        slabs = t;
+        cap = nslab + other.nslab;
+        nslab = k;
+    }
+
+    /**
+     * let go of every slab at once, freeing those no other pool holds.
+     * all objects of this pool must have been destroyed already.
+     */
+    void release() {
+        for (size_t i = 0; i < nslab; ++i)
+            if (ref(slabs[i])->fetch_sub(1, std::memory_order_acq_rel) == 1)delete[] slabs[i];
+        delete[] slabs;
+        slabs = NULL;
+        nslab = cap = 0;
+        fre = cur = lim = NULL;
+        next = 16;
+    }
+};
+
+}
+
+#endif
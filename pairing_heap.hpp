@@ -0,0 +1,295 @@
+#ifndef SJTU_PAIRING_HEAP_HPP
+#define SJTU_PAIRING_HEAP_HPP
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+ * a priority queue like sjtu::priority_queue whose elements can be changed or removed in place.
+ *
+ * push returns a handle to the element, valid until that element is popped or erased,
+ * and update(h, v) or erase(h) reposition or remove it, so callers need not push
+ * duplicates and skip the stale ones. it is a pairing heap: push, merge and raising
+ * an element's priority are O(1), pop, erase and lowering a priority O(log n) amortized.
+ */
+template<typename T, class Compare = std::less<T>>
+class pairing_heap {
+public:
+    struct node {
+        T val;
+        node *ch;//first child
+        node *sib;//next sibling
+        node *pre;//previous sibling, or the parent for a first child
+
+        template<class... Args>
+        node(Args &&... args) : val(std::forward<Args>(args)...), ch(NULL), sib(NULL), pre(NULL) {}
+    };
+
+    class handle {
+    public:
+        node *p;
+
+        handle(node *_p = NULL) : p(_p) {}
+
+        /**
+         * the element, throw invalid_iterator for a null handle.
+         */
+        const T &operator*() const {
+            if (p == NULL)throw invalid_iterator();
+            return p->val;
+        }
+
+        const T *operator->() const noexcept {
+            return &p->val;
+        }
+
+        bool operator==(const handle &rhs) const { return p == rhs.p; }
+
+        bool operator!=(const handle &rhs) const { return p != rhs.p; }
+    };
+
+    node *root;
+    size_t sz;
+
+    pairing_heap() : root(NULL), sz(0) {}
+
+    /**
+     * the first child / next sibling links form a binary tree, copied with an explicit
+     * stack since a pairing heap can be arbitrarily deep.
+     */
+    node *cpy(node *y, size_t n) {
+        if (y == NULL)return NULL;
+        node *ret = NULL, **st = new node *[n], **fa = new node *[n], ***to = new node **[n];
+        size_t k = 0;
+        st[k] = y;
+        fa[k] = NULL;
+        to[k++] = &ret;
+        try {
+            while (k) {
+                y = st[--k];
+                node *x = *to[k] = new node(y->val);
+                x->pre = fa[k];
+                if (y->sib != NULL)st[k] = y->sib, fa[k] = x, to[k++] = &x->sib;
+                if (y->ch != NULL)st[k] = y->ch, fa[k] = x, to[k++] = &x->ch;
+            }
+        } catch (...) {
+            del(ret);
+            delete[] st;
+            delete[] fa;
+            delete[] to;
+            throw;
+        }
+        delete[] st;
+        delete[] fa;
+        delete[] to;
+        return ret;
+    }
+
+    // rotating first children up instead of recursing
+    void del(node *x) {
+        while (x != NULL) {
+            node *y;
+            if (x->ch != NULL)y = x->ch, x->ch = y->sib, y->sib = x;
+            else y = x->sib, delete x;
+            x = y;
+        }
+    }
+
+    /**
+     * handles refer to the elements of other, not to their copies.
+     */
+    pairing_heap(const pairing_heap &other) : root(cpy(other.root, other.sz)), sz(other.sz) {}
+
+    pairing_heap(pairing_heap &&other) noexcept : root(other.root), sz(other.sz) {
+        other.root = NULL;
+        other.sz = 0;
+    }
+
+    pairing_heap &operator=(const pairing_heap &other) {
+        if (this == &other)return *this;
+        node *tmp = cpy(other.root, other.sz);
+        del(root);
+        root = tmp;
+        sz = other.sz;
+        return *this;
+    }
+
+    pairing_heap &operator=(pairing_heap &&other) noexcept {
+        if (this == &other)return *this;
+        del(root);
+        root = other.root;
+        sz = other.sz;
+        other.root = NULL;
+        other.sz = 0;
+        return *this;
+    }
+
+    ~pairing_heap() {
+        del(root);
+    }
+
+    // the two detached heaps as one, the loser becomes the winner's first child
+    static node *meld(node *x, node *y) {
+        if (x == NULL)return y;
+        if (y == NULL)return x;
+        if (Compare()(x->val, y->val))std::swap(x, y);
+        y->sib = x->ch;
+        if (x->ch != NULL)x->ch->pre = y;
+        y->pre = x;
+        x->ch = y;
+        return x;
+    }
+
+    /**
+     * the sibling list starting at x as one detached heap: meld neighbours pairwise
+     * left to right, then the pairs right to left. the first pass stacks its
+     * results through sib, which is what keeps pop O(log n) amortized.
+     */
+    static node *combine(node *x) {
+        node *st = NULL;
+        while (x != NULL) {
+            node *a = x, *b = x->sib;
+            x = b == NULL ? NULL : b->sib;
+            a->sib = a->pre = NULL;
+            if (b != NULL)b->sib = b->pre = NULL;
+            a = meld(a, b);
+            a->sib = st;
+            st = a;
+        }
+        node *ret = NULL;
+        while (st != NULL) {
+            node *a = st;
+            st = st->sib;
+            a->sib = NULL;
+            ret = meld(ret, a);
+        }
+        return ret;
+    }
+
+    // detach the subtree of x, which is not the root, from its parent and siblings
+    static void cut(node *x) {
+        if (x->pre->ch == x)x->pre->ch = x->sib;
+        else x->pre->sib = x->sib;
+        if (x->sib != NULL)x->sib->pre = x->pre;
+        x->sib = x->pre = NULL;
+    }
+
+    /**
+     * get the top of the queue.
+     * @return a reference of the top element.
+     * throw container_is_empty if empty() returns true;
+     */
+    const T &top() const {
+        if (empty())throw container_is_empty();
+        return root->val;
+    }
+
+    handle top_handle() const {
+        if (empty())throw container_is_empty();
+        return handle(root);
+    }
+
+    /**
+     * push new element to the priority queue, return its handle. O(1).
+     */
+    handle push(const T &e) {
+        return emplace(e);
+    }
+
+    handle push(T &&e) {
+        return emplace(std::move(e));
+    }
+
+    template<class... Args>
+    handle emplace(Args &&... args) {
+        node *x = new node(std::forward<Args>(args)...);
+        root = meld(root, x);
+        ++sz;
+        return handle(x);
+    }
+
+    /**
+     * delete the top element.
+     * throw container_is_empty if empty() returns true;
+     */
+    void pop() {
+        if (empty())throw container_is_empty();
+        node *x = root;
+        root = combine(root->ch);
+        delete x;
+        --sz;
+    }
+
+    /**
+     * give the element of h the value v and move it to its new place.
+     * O(1) if v does not compare less than the old value, O(log n) amortized otherwise.
+     * throw invalid_iterator for a null handle.
+     */
+    void update(handle h, const T &v) {
+        node *x = h.p;
+        if (x == NULL)throw invalid_iterator();
+        bool down = Compare()(v, x->val);
+        x->val = v;
+        if (down) {
+            node *c = x->ch;
+            x->ch = NULL;
+            if (x != root)cut(x);
+            else root = NULL;
+            root = meld(meld(root, combine(c)), x);
+        } else if (x != root) {
+            cut(x);
+            root = meld(root, x);
+        }
+    }
+
+    /**
+     * remove the element of h. O(log n) amortized.
+     * throw invalid_iterator for a null handle.
+     */
+    void erase(handle h) {
+        node *x = h.p;
+        if (x == NULL)throw invalid_iterator();
+        if (x == root) {
+            pop();
+            return;
+        }
+        cut(x);
+        root = meld(root, combine(x->ch));
+        delete x;
+        --sz;
+    }
+
+    /**
+     * return the number of the elements.
+     */
+    size_t size() const {
+        return sz;
+    }
+
+    /**
+     * check if the container has at least an element.
+     * @return true if it is empty, false if it has at least an element.
+     */
+    bool empty() const {
+        return !sz;
+    }
+
+    /**
+     * move every element of other here in O(1), their handles stay valid.
+     */
+    void merge(pairing_heap &other) {
+        if (this == &other)return;
+        root = meld(root, other.root);
+        sz += other.sz;
+        other.root = NULL;
+        other.sz = 0;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,277 @@
+#ifndef SJTU_PERSISTENT_MAP_HPP
+#define SJTU_PERSISTENT_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <atomic>
+#include <utility>
+#include "utility.hpp"
+#include "compare_base.hpp"
+#include "exceptions.hpp"
+#include "persistent_tree.hpp"
+
+namespace sjtu {
+
+/**
+ * an ordered map with the interface of sjtu::map whose copies are O(1).
+ *
+ * it is a persistent_tree version: copying (or snapshot()) shares the whole
+ * tree, and a later insert or erase on either side path-copies only the
+ * O(log n) nodes it touches, so versions cost memory only where they differ.
+ * operator[] writes in place when no other version shares the path to the
+ * element, and path-copies it otherwise.
+ *
+ * an iterator pins the version it was taken from: it holds a reference to that
+ * root, so it stays dereferenceable and keeps walking that version's contents
+ * after insert, erase, operator[] or clear, all of which start a new version.
+ * such an iterator is stale: erase(pos) throws invalid_iterator for it, and it
+ * only compares equal to iterators at the same element. the map it came from
+ * must outlive it.
+ *
+ * elements cannot be modified through iterators, and stepping an iterator
+ * costs one descent from the root since nodes have no parent links.
+ * different versions may be used and destroyed from different threads.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>
+> class persistent_map : public compare_base<Compare> {
+public:
+    typedef pair<const Key, T> value_type;
+    typedef persistent_tree<Key, T, Compare> tree;
+    typedef typename tree::node node;
+
+    node *root;
+    size_t sz;
+
+    using compare_base<Compare>::comp;
+
+    class const_iterator {
+    private:
+    public:
+        const persistent_map *belong;
+        node *ver;//the root of the pinned version, held
+        node *cur;//NULL for end()
+
+        bool check_invalid() const { return belong == NULL; }
+
+        bool check_end() const { return cur == NULL; }
+
+        const_iterator() : belong(NULL), ver(NULL), cur(NULL) {}
+
+        const_iterator(const persistent_map *_belong, node *_cur)
+                : belong(_belong), ver(tree::hold(_belong->root)), cur(_cur) {}
+
+        const_iterator(const const_iterator &other) : belong(other.belong), ver(tree::hold(other.ver)), cur(other.cur) {}
+
+        const_iterator(const_iterator &&other) noexcept : belong(other.belong), ver(other.ver), cur(other.cur) {
+            other.ver = NULL;
+        }
+
+        const_iterator &operator=(const const_iterator &other) {
+            node *v = tree::hold(other.ver);
+            tree::drop(ver);
+            belong = other.belong;
+            ver = v;
+            cur = other.cur;
+            return *this;
+        }
+
+        const_iterator &operator=(const_iterator &&other) noexcept {
+            if (this == &other)return *this;
+            tree::drop(ver);
+            belong = other.belong;
+            ver = other.ver;
+            cur = other.cur;
+            other.ver = NULL;
+            return *this;
+        }
+
+        ~const_iterator() {
+            tree::drop(ver);
+        }
+
+        // false once the map has moved on to another version
+        bool current() const { return belong != NULL && ver == belong->root; }
+
+        const_iterator operator++(int) {
+            const_iterator ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        const_iterator &operator++() {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            cur = tree::upper(ver, cur->val.first, belong->comp());
+            return *this;
+        }
+
+        const_iterator operator--(int) {
+            const_iterator ret(*this);
+            --*this;
+            return ret;
+        }
+
+        const_iterator &operator--() {
+            if (check_invalid())throw invalid_iterator();
+            node *x = cur == NULL ? tree::last(ver)
+                                  : tree::before(ver, cur->val.first, belong->comp());
+            if (x == NULL)throw invalid_iterator();
+            cur = x;
+            return *this;
+        }
+
+        const value_type &operator*() const {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            return cur->val;
+        }
+
+        bool operator==(const const_iterator &rhs) const { return belong == rhs.belong && cur == rhs.cur; }
+
+        bool operator!=(const const_iterator &rhs) const { return belong != rhs.belong || cur != rhs.cur; }
+
+        const value_type *operator->() const noexcept {
+            return &cur->val;
+        }
+    };
+
+    typedef const_iterator iterator;
+
+    persistent_map() : root(NULL), sz(0) {}
+
+    explicit persistent_map(const Compare &c) : compare_base<Compare>(c), root(NULL), sz(0) {}
+
+    // O(1), the two maps share every node until one of them changes
+    persistent_map(const persistent_map &other)
+            : compare_base<Compare>(other), root(tree::hold(other.root)), sz(other.sz) {}
+
+    persistent_map(persistent_map &&other) noexcept : compare_base<Compare>(other), root(other.root), sz(other.sz) {
+        other.root = NULL;
+        other.sz = 0;
+    }
+
+    persistent_map &operator=(const persistent_map &other) {
+        if (this == &other)return *this;
+        compare_base<Compare>::operator=(other);
+        replace(tree::hold(other.root));
+        sz = other.sz;
+        return *this;
+    }
+
+    persistent_map &operator=(persistent_map &&other) noexcept {
+        if (this == &other)return *this;
+        compare_base<Compare>::operator=(other);
+        replace(other.root);
+        sz = other.sz;
+        other.root = NULL;
+        other.sz = 0;
+        return *this;
+    }
+
+    ~persistent_map() {
+        tree::drop(root);
+    }
+
+    /**
+     * an O(1) read-only copy of the current contents, unaffected by later writes to this map.
+     */
+    persistent_map snapshot() const {
+        return *this;
+    }
+
+    void replace(node *r) {
+        tree::drop(root);
+        root = r;
+    }
+
+    const T &at(const Key &key) const {
+        node *x = tree::find(root, key, comp());
+        if (x == NULL)throw index_out_of_bound();
+        return x->val.second;
+    }
+
+    /**
+     * inserts T() if key is absent. the reference is valid until the next write to this map.
+     */
+    T &operator[](const Key &key) {
+        node *x = root;
+        bool own = true;//no other version can reach x
+        while (x != NULL) {
+            own = own && x->ref.load(std::memory_order_acquire) == 1;
+            if (comp()(key, x->val.first))x = x->lc;
+            else if (comp()(x->val.first, key))x = x->rc;
+            else break;
+        }
+        if (x == NULL) {
+            replace(tree::insert(root, key, comp(), key, T()));
+            ++sz;
+        } else if (own)return x->val.second;
+        else replace(tree::assign(root, key, comp(), x->val.second));
+        return tree::find(root, key, comp())->val.second;
+    }
+
+    const T &operator[](const Key &key) const {
+        return at(key);
+    }
+
+    const_iterator begin() const { return const_iterator(this, tree::first(root)); }
+
+    const_iterator cbegin() const { return begin(); }
+
+    const_iterator end() const { return const_iterator(this, NULL); }
+
+    const_iterator cend() const { return end(); }
+
+    bool empty() const { return !sz; }
+
+    size_t size() const { return sz; }
+
+    void clear() {
+        replace(NULL);
+        sz = 0;
+    }
+
+    /**
+     * return a pair, the first of the pair is
+     *   the iterator to the new element (or the element that prevented the insertion),
+     *   the second one is true if insert successfully, or false.
+     */
+    pair<iterator, bool> insert(const value_type &value) {
+        node *x = tree::find(root, value.first, comp());
+        if (x != NULL)return pair<iterator, bool>(iterator(this, x), false);
+        replace(tree::insert(root, value.first, comp(), value));
+        ++sz;
+        return pair<iterator, bool>(find(value.first), true);
+    }
+
+    /**
+     * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this
+     * || pos was taken before the last write to this map)
+     */
+    void erase(iterator pos) {
+        if (pos.check_invalid() || pos.check_end() || pos.belong != this || !pos.current())throw invalid_iterator();
+        replace(tree::erase(root, pos.cur->val.first, comp()));
+        --sz;
+    }
+
+    size_t count(const Key &key) const {
+        return tree::find(root, key, comp()) != NULL;
+    }
+
+    const_iterator find(const Key &key) const {
+        return const_iterator(this, tree::find(root, key, comp()));
+    }
+
+    const_iterator lower_bound(const Key &key) const {
+        return const_iterator(this, tree::lower(root, key, comp()));
+    }
+
+    const_iterator upper_bound(const Key &key) const {
+        return const_iterator(this, tree::upper(root, key, comp()));
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef SJTU_PERSISTENT_TREE_HPP
+#define SJTU_PERSISTENT_TREE_HPP
+
+#include <cstddef>
+#include <atomic>
+#include <utility>
+#include "utility.hpp"
+
+namespace sjtu {
+
+/**
+ * an immutable AVL tree with path copying.
+ * an update never touches a reachable node, it builds the O(log n) nodes on the
+ * path to the change and shares every other subtree with the old version, so a
+ * root pointer is a snapshot that stays valid for as long as it is held.
+ *
+ * nodes are reference counted: a node holds one reference to each child, and
+ * whoever keeps a root holds one reference to it. every function returning a
+ * node returns a new reference and leaves the references it was given alone.
+ * the counts are atomic, so versions may be dropped from different threads.
+ */
+template<class Key, class T, class Compare>
+struct persistent_tree {
+    typedef pair<const Key, T> value_type;
+
+    struct node {
+        value_type val;
+        node *lc, *rc;
+        int h;
+        size_t siz;
+        std::atomic<int> ref;
+
+        // takes over the references to l and r
+        template<class... Args>
+        node(node *l, node *r, Args &&... args) : val(std::forward<Args>(args)...), lc(l), rc(r), ref(1) {
+            h = ht(l) > ht(r) ? ht(l) + 1 : ht(r) + 1;
+            siz = size(l) + size(r) + 1;
+        }
+    };
+
+    static int ht(node *x) { return x == NULL ? 0 : x->h; }
+
+    static size_t size(node *x) { return x == NULL ? 0 : x->siz; }
+
+    static node *hold(node *x) {
+        if (x != NULL)x->ref.fetch_add(1, std::memory_order_relaxed);
+        return x;
+    }
+
+    static void drop(node *x) {
+        while (x != NULL && x->ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            node *r = x->rc;
+            drop(x->lc);
+            delete x;
+            x = r;
+        }
+    }
+
+    // a node over v and the owned subtrees l and r, whose heights differ by at most 2
+    static node *bal(const value_type &v, node *l, node *r) {
+        node *ret;
+        if (ht(l) > ht(r) + 1) {
+            if (ht(l->lc) >= ht(l->rc))
+                ret = new node(hold(l->lc), new node(hold(l->rc), r, v), l->val);
+            else {
+                node *m = l->rc;
+                ret = new node(new node(hold(l->lc), hold(m->lc), l->val), new node(hold(m->rc), r, v), m->val);
+            }
+            drop(l);
+        } else if (ht(r) > ht(l) + 1) {
+            if (ht(r->rc) >= ht(r->lc))
+                ret = new node(new node(l, hold(r->lc), v), hold(r->rc), r->val);
+            else {
+                node *m = r->lc;
+                ret = new node(new node(l, hold(m->lc), v), new node(hold(m->rc), hold(r->rc), r->val), m->val);
+            }
+            drop(r);
+        } else ret = new node(l, r, v);
+        return ret;
+    }
+
+    // the node holding key, or NULL; one comparison per level
+    template<class K>
+    static node *find(node *x, const K &key, const Compare &c) {
+        node *y = NULL;
+        while (x != NULL) {
+            if (c(key, x->val.first))x = x->lc;
+            else y = x, x = x->rc;
+        }
+        if (y != NULL && !c(y->val.first, key))return y;
+        return NULL;
+    }
+
+    // first node with key not less than key, NULL if none
+    template<class K>
+    static node *lower(node *x, const K &key, const Compare &c) {
+        node *r = NULL;
+        while (x != NULL) {
+            if (!c(x->val.first, key))r = x, x = x->lc;
+            else x = x->rc;
+        }
+        return r;
+    }
+
+    // first node with key greater than key, NULL if none
+    template<class K>
+    static node *upper(node *x, const K &key, const Compare &c) {
+        node *r = NULL;
+        while (x != NULL) {
+            if (c(key, x->val.first))r = x, x = x->lc;
+            else x = x->rc;
+        }
+        return r;
+    }
+
+    // last node with key less than key, NULL if none
+    template<class K>
+    static node *before(node *x, const K &key, const Compare &c) {
+        node *r = NULL;
+        while (x != NULL) {
+            if (c(x->val.first, key))r = x, x = x->rc;
+            else x = x->lc;
+        }
+        return r;
+    }
+
+    static node *first(node *x) {
+        if (x != NULL)while (x->lc != NULL)x = x->lc;
+        return x;
+    }
+
+    static node *last(node *x) {
+        if (x != NULL)while (x->rc != NULL)x = x->rc;
+        return x;
+    }
+
+    /**
+     * x with a value built from args added. key must not be in x.
+     */
+    template<class... Args>
+    static node *insert(node *x, const Key &key, const Compare &c, Args &&... args) {
+        if (x == NULL)return new node(NULL, NULL, std::forward<Args>(args)...);
+        if (c(key, x->val.first))return bal(x->val, insert(x->lc, key, c, std::forward<Args>(args)...), hold(x->rc));
+        return bal(x->val, hold(x->lc), insert(x->rc, key, c, std::forward<Args>(args)...));
+    }
+
+    /**
+     * x with the mapped value of key replaced by T(args...). key must be in x.
+     */
+    template<class... Args>
+    static node *assign(node *x, const Key &key, const Compare &c, Args &&... args) {
+        if (c(key, x->val.first))return new node(assign(x->lc, key, c, std::forward<Args>(args)...), hold(x->rc), x->val);
+        if (c(x->val.first, key))return new node(hold(x->lc), assign(x->rc, key, c, std::forward<Args>(args)...), x->val);
+        return new node(hold(x->lc), hold(x->rc), x->val.first, T(std::forward<Args>(args)...));
+    }
+
+    static node *erase_min(node *x) {
+        if (x->lc == NULL)return hold(x->rc);
+        return bal(x->val, erase_min(x->lc), hold(x->rc));
+    }
+
+    /**
+     * x without key. key must be in x.
+     */
+    static node *erase(node *x, const Key &key, const Compare &c) {
+        if (c(key, x->val.first))return bal(x->val, erase(x->lc, key, c), hold(x->rc));
+        if (c(x->val.first, key))return bal(x->val, hold(x->lc), erase(x->rc, key, c));
+        if (x->lc == NULL)return hold(x->rc);
+        if (x->rc == NULL)return hold(x->lc);
+        node *m = x->rc;
+        while (m->lc != NULL)m = m->lc;
+        return bal(m->val, hold(x->lc), erase_min(x->rc));
+    }
+
+    // calls f(val) for every node under x in key order
+    template<class F>
+    static void for_each(node *x, F &f) {
+        while (x != NULL) {
+            for_each(x->lc, f);
+            f(static_cast<const value_type &>(x->val));
+            x = x->rc;
+        }
+    }
+};
+
+}
+
+#endif
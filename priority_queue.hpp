@@ -2,15 +2,25 @@
 #define SJTU_PRIORITY_QUEUE_HPP
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <utility>
 #include "exceptions.hpp"
+#include "node_pool.hpp"
 
 namespace sjtu {
 
 /**
  * a container like std::priority_queue which is a heap internal.
+ *
+ * nodes come from a per-queue Pool<node>, sjtu::node_pool by default, the same hook as sjtu::map.
+ * popped nodes go back to its free list, so once the queue has reached its peak size
+ * push and pop do not call the system allocator. the pool keeps that peak's memory, and
+ * after merge it also holds the memory of the other queue's pool, so it can hold far more
+ * than size() nodes. set_max_free(m) bounds that: once more than m and more than size()
+ * nodes are free, pop moves the elements into a fresh pool and lets the old memory go.
  */
-template<typename T, class Compare = std::less<T>>
+template<typename T, class Compare = std::less<T>, template<class> class Pool = node_pool>
 class priority_queue {
 public:
 	struct node {
@@ -18,33 +28,92 @@ public:
         int dist;
         struct node *lc, *rc;
 
-        node(const T &x,const int y=0) : val(x), dist(y), lc(NULL), rc(NULL) {}
+        template<class... Args>
+        node(Args &&... args) : val(std::forward<Args>(args)...), dist(0), lc(NULL), rc(NULL) {}
     };
 	node *TOP;
 	size_t SIZE;
+	Pool<node> pool;
+	size_t nfree;//nodes freed into pool and not reused since the last compact()
+	size_t max_free;
+	template<class... Args>
+	node *new_node(Args &&... args) {
+	    node *x = pool.allocate();
+	    try {
+	        new(x) node(std::forward<Args>(args)...);
+	    } catch (...) {
+	        pool.deallocate(x);
+	        throw;
+	    }
+	    if (nfree)--nfree;
+	    return x;
+	}
+	void delete_node(node *x) {
+	    x->~node();
+	    pool.deallocate(x);
+	    ++nfree;
+	}
 	priority_queue() {
-	    TOP=NULL;SIZE=0;
+	    TOP=NULL;SIZE=0;nfree=0;max_free=SIZE_MAX;
+	}
+	/**
+	 * builds the queue from [first, last) in O(n), see push_range.
+	 */
+	template<class InputIt>
+	priority_queue(InputIt first, InputIt last) {
+	    TOP=NULL;SIZE=0;nfree=0;max_free=SIZE_MAX;
+	    push_range(first, last);
 	}
-	node* cpy(node *y) {
+	/**
+	 * the left spine of a leftist heap can be O(n) long, so copying and destroying
+	 * use an explicit stack and rotations rather than recursion.
+	 */
+	node* cpy(node *y, size_t n) {
         if (y == NULL) {
             return NULL;
         }
-        node *ret = new node(y->val, y->dist);
-        ret->lc = cpy(y->lc);
-        ret->rc = cpy(y->rc);
+        pool.reserve(n);
+        node *ret = NULL, **st = new node *[n], ***to = new node **[n];
+        size_t k = 0;
+        st[k] = y;
+        to[k++] = &ret;
+        try {
+            while (k) {
+                y = st[--k];
+                node *x = *to[k] = new_node(y->val);
+                x->dist = y->dist;
+                if (y->rc != NULL)st[k] = y->rc, to[k++] = &x->rc;
+                if (y->lc != NULL)st[k] = y->lc, to[k++] = &x->lc;
+            }
+        } catch (...) {
+            del(ret);
+            delete[] st;
+            delete[] to;
+            throw;
+        }
+        delete[] st;
+        delete[] to;
         return ret;
     }
 	priority_queue(const priority_queue &other) {
-	    TOP=cpy(other.TOP);
+	    nfree=0;max_free=other.max_free;
+	    TOP=cpy(other.TOP,other.SIZE);
 	    SIZE=other.SIZE;
 	}
+	priority_queue(priority_queue &&other) noexcept : pool(std::move(other.pool)) {
+	    TOP=other.TOP;SIZE=other.SIZE;nfree=other.nfree;max_free=other.max_free;
+	    other.TOP=NULL;other.SIZE=0;other.nfree=0;
+	}
 	/**
 	 * TODO deconstructor
 	 */
 	void del(node *x){
-	    if(x==NULL)return;
-	    del(x->lc);del(x->rc);
-	    delete x;
+	    while(x!=NULL){
+	        node *y;
+	        if(x->lc!=NULL)y=x->lc,x->lc=y->rc,y->rc=x;
+	        else y=x->rc,delete_node(x);
+	        x=y;
+	    }
 	}
 	~priority_queue() {
 	    del(TOP);
@@ -52,20 +121,43 @@ public:
 	/**
 	 * TODO Assignment operator
 	 */
+	/**
+	 * merge down the right spines, then fix dist and children back up.
+	 * a right spine is at most 64 nodes long (dist d needs 2^(d+1)-1 nodes), so a fixed stack does.
+	 */
 	 node *Merge(node *x,node *y) {
-        if (y == NULL)return x;
-        if (x == NULL)return y;
-        if (Compare()(x->val, y->val))std::swap(x, y);
-        x->rc = Merge(x->rc, y);
-        if (x->lc == NULL || (x->rc != NULL && x->rc->dist > x->lc->dist))std::swap(x->lc, x->rc);
-        x->dist = x->rc == NULL ? 0 : x->rc->dist + 1;
+        node *st[128];
+        int k = 0;
+        while (x != NULL && y != NULL) {
+            if (Compare()(x->val, y->val))std::swap(x, y);
+            st[k++] = x;
+            x = x->rc;
+        }
+        if (x == NULL)x = y;
+        while (k) {
+            y = st[--k];
+            y->rc = x;
+            if (y->lc == NULL || (y->rc != NULL && y->rc->dist > y->lc->dist))std::swap(y->lc, y->rc);
+            y->dist = y->rc == NULL ? 0 : y->rc->dist + 1;
+            x = y;
+        }
         return x;
     }
 	priority_queue &operator=(const priority_queue &other) {
 	     if(this==&other)return *this;
+	     node *tmp=cpy(other.TOP,other.SIZE);
 	     del(TOP);
-	     TOP=cpy(other.TOP);
+	     TOP=tmp;
 	     SIZE=other.SIZE;
+	     max_free=other.max_free;
+	     return *this;
+	 }
+	priority_queue &operator=(priority_queue &&other) noexcept {
+	     if(this==&other)return *this;
+	     del(TOP);
+	     pool=std::move(other.pool);
+	     TOP=other.TOP;SIZE=other.SIZE;nfree=other.nfree;max_free=other.max_free;
+	     other.TOP=NULL;other.SIZE=0;other.nfree=0;
 	     return *this;
 	 }
 	/**
@@ -82,10 +174,62 @@ public:
 	 * push new element to the priority queue.
 	 */
 	void push(const T &e) {
-	    node *tmp=new node(e);
+	    emplace(e);
+	}
+	void push(T &&e) {
+	    emplace(std::move(e));
+	}
+	/**
+	 * construct a new element in place from args.
+	 */
+	template<class... Args>
+	void emplace(Args &&... args) {
+	    node *tmp=new_node(std::forward<Args>(args)...);
 	    TOP=Merge(TOP,tmp);
 	    ++SIZE;
 	}
+	/**
+	 * a heap of the elements of [first, last) in O(n), its size in n.
+	 * the singletons are merged pairwise in rounds, like the passes of a bottom-up
+	 * merge sort: round r does n / 2^r merges of heaps of size 2^(r-1), O(r) each.
+	 */
+	template<class InputIt>
+	node *build(InputIt first, InputIt last, size_t &n) {
+	    node **a = NULL;
+	    size_t cap = 0;
+	    n = 0;
+	    try {
+	        for (; first != last; ++first) {
+	            if (n == cap) {
+	                node **t = new node *[cap = cap ? cap * 2 : 16];
+	                for (size_t i = 0; i < n; ++i)t[i] = a[i];
+	                delete[] a;
+	                a = t;
+	            }
+	            a[n] = new_node(*first);
+	            ++n;
+	        }
+	    } catch (...) {
+	        for (size_t i = 0; i < n; ++i)delete_node(a[i]);
+	        delete[] a;
+	        throw;
+	    }
+	    for (size_t m = n; m > 1; m = (m + 1) / 2)
+	        for (size_t i = 0; i < m; i += 2)a[i / 2] = i + 1 < m ? Merge(a[i], a[i + 1]) : a[i];
+	    node *ret = n ? a[0] : NULL;
+	    delete[] a;
+	    return ret;
+	}
+	/**
+	 * push the elements of [first, last), O(k + log n) for k new elements.
+	 */
+	template<class InputIt>
+	void push_range(InputIt first, InputIt last) {
+	    size_t n;
+	    node *x = build(first, last, n);
+	    TOP = Merge(TOP, x);
+	    SIZE += n;
+	}
 	/**
 	 * TODO
 	 * delete the top element.
@@ -95,8 +239,66 @@ public:
         if(empty())throw container_is_empty();
 	    node *tmp=TOP;
 	    TOP=Merge(TOP->lc,TOP->rc);
-	    delete tmp;
+	    delete_node(tmp);
 	    --SIZE;
+	    if(nfree>max_free&&nfree>SIZE)compact();
+	}
+	/**
+	 * delete the top element and return it, moved out rather than copied.
+	 * throw container_is_empty if empty() returns true;
+	 */
+	T pop_top() {
+	    if(empty())throw container_is_empty();
+	    T ret(std::move(TOP->val));
+	    pop();
+	    return ret;
+	}
+	/**
+	 * bound the free nodes kept for reuse, see compact(). SIZE_MAX (the default) for no bound.
+	 */
+	void set_max_free(size_t m) {
+	    max_free=m;
+	}
+	/**
+	 * move every element into a fresh pool sized for them and let the old pool go,
+	 * with the memory merge made it share. O(size()); pop only calls it once more
+	 * than size() nodes have been freed, so that is O(1) amortized per pop.
+	 * if the memory for the move cannot be had, nothing changes.
+	 */
+	void compact() {
+	    nfree=0;
+	    if(TOP==NULL){
+	        pool=Pool<node>();
+	        return;
+	    }
+	    node **st=NULL,***to=NULL;
+	    Pool<node> old(std::move(pool));
+	    pool=Pool<node>();
+	    try {
+	        st=new node *[SIZE];
+	        to=new node **[SIZE];
+	        pool.reserve(SIZE);
+	    } catch (...) {
+	        delete[] st;
+	        delete[] to;
+	        pool=std::move(old);
+	        return;
+	    }
+	    node *y,*ret=NULL;
+	    size_t k=0;
+	    st[k]=TOP;
+	    to[k++]=&ret;
+	    while(k){
+	        y=st[--k];
+	        node *x=*to[k]=new(pool.allocate()) node(std::move(y->val));
+	        x->dist=y->dist;
+	        if(y->rc!=NULL)st[k]=y->rc,to[k++]=&x->rc;
+	        if(y->lc!=NULL)st[k]=y->lc,to[k++]=&x->lc;
+	        y->~node();
+	    }
+	    delete[] st;
+	    delete[] to;
+	    TOP=ret;
 	}
 	/**
 	 * return the number of the elements.
@@ -113,13 +315,56 @@ public:
     }
 	/**
 	 * return a merged priority_queue with at least O(logn) complexity.
+	 * the nodes of other move here, so the two pools share() their memory from now on.
 	 */
 	void merge(priority_queue &other) {
+        if (this == &other)return;
+        pool.share(other.pool);
         TOP = Merge(TOP, other.TOP);
         SIZE += other.SIZE;
         other.TOP = NULL;
         other.SIZE = 0;
     }
+	/**
+	 * move the smaller of the two subtrees below the top into other, return how many
+	 * elements moved. O(k + log n) for k moved: the subtrees are counted in step until
+	 * the smaller one is done. as with merge, the two pools share() their memory from now on.
+	 */
+	size_t split(priority_queue &other) {
+        if (this == &other || TOP == NULL || TOP->rc == NULL)return 0;
+        node **st[2] = {new node *[SIZE], NULL};
+        try {
+            st[1] = new node *[SIZE];
+            other.pool.share(pool);
+        } catch (...) {
+            delete[] st[0];
+            delete[] st[1];
+            throw;
+        }
+        size_t k[2] = {1, 1}, c[2] = {0, 0};
+        st[0][0] = TOP->lc;
+        st[1][0] = TOP->rc;
+        while (k[0] && k[1]) {
+            for (int i = 0; i < 2; ++i) {
+                if (!k[i])continue;
+                node *y = st[i][--k[i]];
+                ++c[i];
+                if (y->lc != NULL)st[i][k[i]++] = y->lc;
+                if (y->rc != NULL)st[i][k[i]++] = y->rc;
+            }
+        }
+        delete[] st[0];
+        delete[] st[1];
+        int i = k[0] ? 1 : k[1] ? 0 : c[1] < c[0];
+        node *x = i ? TOP->rc : TOP->lc;
+        if (!i)TOP->lc = TOP->rc;
+        TOP->rc = NULL;
+        TOP->dist = 0;
+        other.TOP = other.Merge(other.TOP, x);
+        SIZE -= c[i];
+        other.SIZE += c[i];
+        return c[i];
+    }
 };
 
 }
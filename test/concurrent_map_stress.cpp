@@ -0,0 +1,89 @@
+/**
+ * stress test of sjtu::concurrent_map: readers and writers run at once and every
+ * version a reader sees must be consistent. meant to be run under ThreadSanitizer
+ * (configure with -DSJTU_TSAN=ON), which also catches a version freed too early.
+ * usage: concurrent_map_stress [readers] [writers] [ops per writer]
+ */
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <thread>
+#include <vector>
+#include "concurrent_map.hpp"
+
+#define CHECK(c) do { if (!(c)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #c); abort(); } } while (0)
+
+typedef sjtu::concurrent_map<int, long> cmap;
+
+const int KEYS = 4096;
+
+int main(int argc, char **argv) {
+    int R = argc > 1 ? atoi(argv[1]) : 4, W = argc > 2 ? atoi(argv[2]) : 2, OPS = argc > 3 ? atoi(argv[3]) : 20000;
+    cmap m;
+    // writer w owns the keys k with k % W == w and stores k * 10 + generation
+    std::vector<std::map<int, long> > shadow(W);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> th;
+    for (int t = 0; t < R; ++t)
+        th.emplace_back([&, t] {
+            unsigned x = t * 2654435761u + 1;
+            for (long n = 0; !stop.load(std::memory_order_relaxed); ++n) {
+                x = x * 1103515245 + 12345;
+                int k = (x >> 8) % KEYS;
+                long v;
+                if (m.find(k, v))CHECK(v / 10 == k);
+                m.visit(k, [&](const cmap::value_type &p) { CHECK(p.first == k && p.second / 10 == k); });
+                if (n % 256)continue;
+                // one whole version: sorted keys, each with its own value
+                int last = -1;
+                size_t c = 0;
+                m.for_each([&](const cmap::value_type &p) {
+                    CHECK(p.first > last && p.second / 10 == p.first);
+                    last = p.first;
+                    ++c;
+                });
+                CHECK(c <= (size_t) KEYS);
+            }
+        });
+    std::vector<std::thread> wr;
+    for (int w = 0; w < W; ++w)
+        wr.emplace_back([&, w] {
+            unsigned x = w * 40503u + 7;
+            std::map<int, long> &s = shadow[w];
+            for (int i = 0; i < OPS; ++i) {
+                x = x * 1103515245 + 12345;
+                int k = (int) ((x >> 8) % (KEYS / W)) * W + w;
+                long v = k * 10L + i % 10;
+                switch ((x >> 4) % 4) {
+                    case 0:
+                        CHECK(m.insert(cmap::value_type(k, v)) == !s.count(k));
+                        s.insert(std::make_pair(k, v));
+                        break;
+                    case 1:
+                        m.insert_or_assign(k, v);
+                        s[k] = v;
+                        break;
+                    case 2:
+                        CHECK(m.erase(k) == s.erase(k));
+                        break;
+                    default:
+                        if (i % 1000 == 0)m.reclaim();
+                        CHECK(m.count(k) == s.count(k));
+                }
+            }
+        });
+    for (auto &t : wr)t.join();
+    stop = true;
+    for (auto &t : th)t.join();
+    size_t total = 0;
+    for (int w = 0; w < W; ++w) {
+        total += shadow[w].size();
+        for (auto &p : shadow[w])CHECK(m.at(p.first) == p.second);
+    }
+    CHECK(m.size() == total);
+    m.clear();
+    CHECK(m.empty());
+    printf("ok: %d readers, %d writers, %d ops each\n", R, W, OPS);
+    return 0;
+}
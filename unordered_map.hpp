@@ -0,0 +1,494 @@
+#ifndef SJTU_UNORDERED_MAP_HPP
+#define SJTU_UNORDERED_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include "utility.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+ * a hash map with the interface of sjtu::map, minus the ordering.
+ *
+ * open addressing in the swiss table layout: one control byte per slot, holding
+ * EMPTY, DELETED, or 7 bits of the key's hash when full. slots are probed in
+ * aligned groups of GROUP, and a whole group is tested against the hash byte at
+ * once with word arithmetic (SWAR), so a lookup usually compares one key and
+ * touches one group of control bytes even at the 7/8 maximum load factor.
+ *
+ * iterators visit the elements in slot order and are invalidated by any insert
+ * that grows the table.
+ */
+template<
+	class Key,
+	class T,
+	class Hash = std::hash<Key>,
+	class Equal = std::equal_to<Key>
+> class unordered_map {
+public:
+    typedef pair<const Key, T> value_type;
+    typedef unsigned long long word;
+
+    enum {
+        GROUP = 8,
+        EMPTY = -128,
+        DELETED = -2
+    };
+
+    signed char *ctrl;
+    value_type *slot;
+    size_t cap, sz;
+    size_t left;//empty slots that may still be filled before a rehash
+    Hash hasher;
+    Equal eq;
+
+    static word load(const signed char *p) {
+        word w;
+        memcpy(&w, p, sizeof(w));
+        return w;
+    }
+
+    // high bit set in each byte of w equal to h (rare false positives are filtered by the key compare)
+    static word match(word w, unsigned char h) {
+        word x = w ^ (0x0101010101010101ull * h);
+        return (x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull;
+    }
+
+    static word match_empty(word w) {
+        return w & (~w << 6) & 0x8080808080808080ull;
+    }
+
+    static word match_free(word w) {
+        return w & (~w << 7) & 0x8080808080808080ull;
+    }
+
+    // byte index of the lowest match
+    static size_t first(word m) {
+        return __builtin_ctzll(m) >> 3;
+    }
+
+    word hash(const Key &key) const {
+        word h = (word) hasher(key) * 0x9e3779b97f4a7c15ull;
+        return h ^ (h >> 32);
+    }
+
+    class const_iterator;
+
+    class iterator {
+    private:
+    public:
+        unordered_map *belong;
+        size_t idx;
+
+        bool check_invalid() const { return belong == NULL; }
+
+        bool check_end() const { return idx >= belong->cap; }
+
+        iterator(unordered_map *_belong = NULL, size_t _idx = 0) : belong(_belong), idx(_idx) {}
+
+        iterator operator++(int) {
+            iterator ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        iterator &operator++() {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            idx = belong->next(idx + 1);
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator ret(*this);
+            --*this;
+            return ret;
+        }
+
+        iterator &operator--() {
+            if (check_invalid())throw invalid_iterator();
+            idx = belong->prev(idx);
+            return *this;
+        }
+
+        value_type &operator*() const {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            return belong->slot[idx];
+        }
+
+        bool operator==(const iterator &rhs) const { return belong == rhs.belong && idx == rhs.idx; }
+
+        bool operator==(const const_iterator &rhs) const { return belong == rhs.belong && idx == rhs.idx; }
+
+        bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+
+        bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+
+        value_type *operator->() const noexcept {
+            return belong->slot + idx;
+        }
+    };
+
+    class const_iterator {
+    private:
+    public:
+        const unordered_map *belong;
+        size_t idx;
+
+        bool check_invalid() const { return belong == NULL; }
+
+        bool check_end() const { return idx >= belong->cap; }
+
+        const_iterator(const unordered_map *_belong = NULL, size_t _idx = 0) : belong(_belong), idx(_idx) {}
+
+        const_iterator(const iterator &other) : belong(other.belong), idx(other.idx) {}
+
+        const_iterator operator++(int) {
+            const_iterator ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        const_iterator &operator++() {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            idx = belong->next(idx + 1);
+            return *this;
+        }
+
+        const_iterator operator--(int) {
+            const_iterator ret(*this);
+            --*this;
+            return ret;
+        }
+
+        const_iterator &operator--() {
+            if (check_invalid())throw invalid_iterator();
+            idx = belong->prev(idx);
+            return *this;
+        }
+
+        const value_type &operator*() const {
+            if (check_invalid() || check_end())throw invalid_iterator();
+            return belong->slot[idx];
+        }
+
+        bool operator==(const const_iterator &rhs) const { return belong == rhs.belong && idx == rhs.idx; }
+
+        bool operator==(const iterator &rhs) const { return belong == rhs.belong && idx == rhs.idx; }
+
+        bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+
+        bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+
+        const value_type *operator->() const noexcept {
+            return belong->slot + idx;
+        }
+    };
+
+    unordered_map() : ctrl(NULL), slot(NULL), cap(0), sz(0), left(0) {}
+
+    explicit unordered_map(const Hash &h, const Equal &e = Equal())
+            : ctrl(NULL), slot(NULL), cap(0), sz(0), left(0), hasher(h), eq(e) {}
+
+    unordered_map(const unordered_map &other)
+            : ctrl(NULL), slot(NULL), cap(0), sz(0), left(other.left), hasher(other.hasher), eq(other.eq) {
+        if (!other.cap)return;
+        ctrl = new signed char[other.cap];
+        memcpy(ctrl, other.ctrl, other.cap);
+        slot = (value_type *) ::operator new(other.cap * sizeof(value_type));
+        size_t i = 0;
+        try {
+            for (; i < other.cap; ++i)if (ctrl[i] >= 0)new(slot + i) value_type(other.slot[i]);
+        } catch (...) {
+            while (i--)if (ctrl[i] >= 0)slot[i].~value_type();
+            delete[] ctrl;
+            ::operator delete(slot);
+            throw;
+        }
+        cap = other.cap;
+        sz = other.sz;
+    }
+
+    unordered_map(unordered_map &&other) noexcept
+            : ctrl(other.ctrl), slot(other.slot), cap(other.cap), sz(other.sz), left(other.left),
+              hasher(other.hasher), eq(other.eq) {
+        other.ctrl = NULL;
+        other.slot = NULL;
+        other.cap = other.sz = other.left = 0;
+    }
+
+    void del() {
+        for (size_t i = 0; i < cap; ++i)if (ctrl[i] >= 0)slot[i].~value_type();
+        delete[] ctrl;
+        ::operator delete(slot);
+        ctrl = NULL;
+        slot = NULL;
+        cap = sz = left = 0;
+    }
+
+    unordered_map &operator=(const unordered_map &other) {
+        if (this == &other)return *this;
+        unordered_map tmp(other);
+        return *this = std::move(tmp);
+    }
+
+    unordered_map &operator=(unordered_map &&other) noexcept {
+        if (this == &other)return *this;
+        del();
+        ctrl = other.ctrl;
+        slot = other.slot;
+        cap = other.cap;
+        sz = other.sz;
+        left = other.left;
+        hasher = other.hasher;
+        eq = other.eq;
+        other.ctrl = NULL;
+        other.slot = NULL;
+        other.cap = other.sz = other.left = 0;
+        return *this;
+    }
+
+    ~unordered_map() {
+        del();
+    }
+
+    // first full slot at or after i, or cap
+    size_t next(size_t i) const {
+        while (i < cap && ctrl[i] < 0)++i;
+        return i;
+    }
+
+    // last full slot before i, throw if none
+    size_t prev(size_t i) const {
+        while (i && ctrl[--i] < 0);
+        if (i >= cap || ctrl[i] < 0)throw invalid_iterator();
+        return i;
+    }
+
+    // slot of key, or cap
+    size_t search(const Key &key) const {
+        if (!cap)return 0;
+        word h = hash(key);
+        size_t mask = cap / GROUP - 1, g = (h >> 7) & mask;
+        for (size_t i = 1;; ++i) {
+            word w = load(ctrl + g * GROUP);
+            for (word m = match(w, h & 0x7f); m; m &= m - 1) {
+                size_t j = g * GROUP + first(m);
+                if (eq(slot[j].first, key))return j;
+            }
+            if (match_empty(w))return cap;
+            g = (g + i) & mask;
+        }
+    }
+
+    // first EMPTY or DELETED slot on the probe sequence of h
+    size_t free_slot(word h) const {
+        size_t mask = cap / GROUP - 1, g = (h >> 7) & mask;
+        for (size_t i = 1;; ++i) {
+            word m = match_free(load(ctrl + g * GROUP));
+            if (m)return g * GROUP + first(m);
+            g = (g + i) & mask;
+        }
+    }
+
+    /**
+     * move every element into a table of c slots, dropping the DELETED markers.
+     * c is a power of two, at least GROUP, with room for sz elements.
+     */
+    void rehash(size_t c) {
+        signed char *oc = ctrl;
+        value_type *os = slot;
+        size_t on = cap;
+        ctrl = new signed char[c];
+        try {
+            slot = (value_type *) ::operator new(c * sizeof(value_type));
+        } catch (...) {
+            delete[] ctrl;
+            ctrl = oc;
+            throw;
+        }
+        memset(ctrl, EMPTY, c);
+        cap = c;
+        for (size_t i = 0; i < on; ++i) {
+            if (oc[i] < 0)continue;
+            size_t j = free_slot(hash(os[i].first));
+            ctrl[j] = oc[i];
+            new(slot + j) value_type(std::move(os[i]));
+            os[i].~value_type();
+        }
+        left = c - c / 8 - sz;
+        delete[] oc;
+        ::operator delete(os);
+    }
+
+    /**
+     * the slot of key if found is set, else a free slot to put it in,
+     * rehashing first when the table is out of empty slots.
+     */
+    size_t prepare(const Key &key, word h, bool &found) {
+        found = false;
+        size_t fr = cap;
+        if (cap) {
+            size_t mask = cap / GROUP - 1, g = (h >> 7) & mask;
+            for (size_t i = 1;; ++i) {
+                word w = load(ctrl + g * GROUP);
+                for (word m = match(w, h & 0x7f); m; m &= m - 1) {
+                    size_t j = g * GROUP + first(m);
+                    if (eq(slot[j].first, key))return found = true, j;
+                }
+                if (fr == cap) {
+                    word m = match_free(w);
+                    if (m)fr = g * GROUP + first(m);
+                }
+                if (match_empty(w))break;
+                g = (g + i) & mask;
+            }
+            if (ctrl[fr] == DELETED || left)return fr;
+        }
+        // mostly DELETED markers: clean up in place, else double
+        rehash(!cap ? (size_t) GROUP : sz * 16 >= cap * 7 ? cap * 2 : cap);
+        return free_slot(h);
+    }
+
+    // construct the element for key at the free slot i
+    template<class... Args>
+    iterator place(size_t i, word h, Args &&... args) {
+        new(slot + i) value_type(std::forward<Args>(args)...);
+        if (ctrl[i] == EMPTY)--left;
+        ctrl[i] = h & 0x7f;
+        ++sz;
+        return iterator(this, i);
+    }
+
+    /**
+     * make room for n elements without rehashing.
+     */
+    void reserve(size_t n) {
+        size_t c = cap ? cap : (size_t) GROUP;
+        while (c - c / 8 < n)c <<= 1;
+        if (c > cap)rehash(c);
+    }
+
+    T &at(const Key &key) {
+        size_t i = search(key);
+        if (i == cap)throw index_out_of_bound();
+        return slot[i].second;
+    }
+
+    const T &at(const Key &key) const {
+        size_t i = search(key);
+        if (i == cap)throw index_out_of_bound();
+        return slot[i].second;
+    }
+
+    T &operator[](const Key &key) {
+        word h = hash(key);
+        bool found;
+        size_t i = prepare(key, h, found);
+        if (found)return slot[i].second;
+        return place(i, h, key, T())->second;
+    }
+
+    T &operator[](Key &&key) {
+        word h = hash(key);
+        bool found;
+        size_t i = prepare(key, h, found);
+        if (found)return slot[i].second;
+        return place(i, h, std::move(key), T())->second;
+    }
+
+    const T &operator[](const Key &key) const {
+        return at(key);
+    }
+
+    iterator begin() { return iterator(this, next(0)); }
+
+    const_iterator cbegin() const { return const_iterator(this, next(0)); }
+
+    iterator end() { return iterator(this, cap); }
+
+    const_iterator cend() const { return const_iterator(this, cap); }
+
+    bool empty() const { return !sz; }
+
+    size_t size() const { return sz; }
+
+    /**
+     * keeps the table, so refilling it does not rehash.
+     */
+    void clear() {
+        for (size_t i = 0; i < cap; ++i)if (ctrl[i] >= 0)slot[i].~value_type();
+        if (cap)memset(ctrl, EMPTY, cap);
+        sz = 0;
+        left = cap - cap / 8;
+    }
+
+    /**
+     * return a pair, the first of the pair is
+     *   the iterator to the new element (or the element that prevented the insertion),
+     *   the second one is true if insert successfully, or false.
+     */
+    pair<iterator, bool> insert(const value_type &value) {
+        word h = hash(value.first);
+        bool found;
+        size_t i = prepare(value.first, h, found);
+        if (found)return pair<iterator, bool>(iterator(this, i), false);
+        return pair<iterator, bool>(place(i, h, value), true);
+    }
+
+    pair<iterator, bool> insert(value_type &&value) {
+        word h = hash(value.first);
+        bool found;
+        size_t i = prepare(value.first, h, found);
+        if (found)return pair<iterator, bool>(iterator(this, i), false);
+        return pair<iterator, bool>(place(i, h, std::move(value)), true);
+    }
+
+    template<class... Args>
+    pair<iterator, bool> emplace(Args &&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    template<class... Args>
+    pair<iterator, bool> try_emplace(const Key &key, Args &&... args) {
+        word h = hash(key);
+        bool found;
+        size_t i = prepare(key, h, found);
+        if (found)return pair<iterator, bool>(iterator(this, i), false);
+        return pair<iterator, bool>(place(i, h, key, T(std::forward<Args>(args)...)), true);
+    }
+
+    /**
+     * erase the element at pos.
+     * a slot goes back to EMPTY only if its group still has an EMPTY one,
+     * since no probe can have passed through such a group.
+     *
+     * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+     */
+    void erase(iterator pos) {
+        if (pos.check_invalid() || pos.belong != this || pos.check_end() || ctrl[pos.idx] < 0)
+            throw invalid_iterator();
+        slot[pos.idx].~value_type();
+        if (match_empty(load(ctrl + pos.idx / GROUP * GROUP)))ctrl[pos.idx] = EMPTY, ++left;
+        else ctrl[pos.idx] = DELETED;
+        --sz;
+    }
+
+    size_t count(const Key &key) const {
+        return search(key) != cap;
+    }
+
+    iterator find(const Key &key) {
+        return iterator(this, search(key));
+    }
+
+    const_iterator find(const Key &key) const {
+        return const_iterator(this, search(key));
+    }
+};
+
+}
+
+#endif